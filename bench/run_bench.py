@@ -0,0 +1,130 @@
+#!/usr/bin/env python3
+"""Run the toyMC benchmark cases and append their results to a file.
+
+Every case of bench/ is run with the same master seed and thread count;
+events/s, steps/s, optical photons/s, initialization time and peak RSS are
+read from the telemetry file of the run, the output size per event from the
+output file and its .meta sidecar. One JSON line per invocation is appended
+to the results file, tagged with the git commit, so runs on the same machine
+can be compared across commits, or physics lists (--physics):
+
+  make bench            (or)
+  bench/run_bench.py --toymc build/toyMC --output bench_results.jsonl
+  bench/run_bench.py --toymc build/toyMC --physics em4 ej200_optics
+"""
+
+import argparse
+import json
+import os
+import platform
+import subprocess
+import sys
+import time
+
+CASES = ["ej200_optics", "ej200_cuts", "ej200_nooptics", "ej276_optics",
+         "highstats"]
+
+
+def git_commit(source_dir):
+    try:
+        return subprocess.check_output(
+            ["git", "-C", source_dir, "rev-parse", "--short", "HEAD"],
+            stderr=subprocess.DEVNULL).decode().strip()
+    except (OSError, subprocess.CalledProcessError):
+        return "unknown"
+
+
+def read_meta(path):
+    meta = {}
+    if os.path.exists(path):
+        with open(path) as f:
+            for line in f:
+                key, _, value = line.strip().partition(" ")
+                meta[key] = value
+    return meta
+
+
+def run_case(args, case, source_dir):
+    os.makedirs(args.workdir, exist_ok=True)
+    out = os.path.join(args.workdir, case)
+    telemetry = out + ".json"
+    for stale in (telemetry, out + ".root", out + ".meta"):
+        if os.path.exists(stale):
+            os.remove(stale)
+
+    # The bench macros refer to each other relative to the source tree
+    wrapper = out + ".mac"
+    with open(wrapper, "w") as f:
+        f.write("/toy/telemetry/file %s\n" % os.path.abspath(telemetry))
+        f.write("/toy/telemetry/interval 5 s\n")
+        f.write("/control/execute bench/%s.mac\n" % case)
+
+    command = [os.path.abspath(args.toymc), os.path.abspath(wrapper),
+               os.path.abspath(out), "-s", str(args.seed),
+               "-t", str(args.threads), "-p", args.physics]
+    start = time.time()
+    with open(out + ".log", "w") as log:
+        status = subprocess.call(command, cwd=source_dir, stdout=log,
+                                 stderr=subprocess.STDOUT)
+    wall = time.time() - start
+    if status != 0 or not os.path.exists(telemetry):
+        print("%-16s FAILED (see %s.log)" % (case, out))
+        return {"case": case, "status": status}
+
+    with open(telemetry) as f:
+        t = json.load(f)
+    events = int(read_meta(out + ".meta").get("events", t["events_done"]))
+    size = os.path.getsize(out + ".root") if os.path.exists(out + ".root") else 0
+    result = {
+        "case": case,
+        "events": events,
+        "wall_s": round(wall, 3),
+        "init_s": t["init_s"],
+        "events_per_s": t["events_per_s"],
+        "steps_per_s": t["steps_per_s"],
+        "optical_photons_per_s": t["optical_photons_per_s"],
+        "peak_rss_kb": t["peak_rss_kb"],
+        "output_bytes_per_event": round(size / events, 1) if events else 0,
+    }
+    print("%-16s %10.1f ev/s %12.0f steps/s %12.0f photons/s "
+          "init %6.2f s  rss %7d kB  %8.1f B/ev"
+          % (case, result["events_per_s"], result["steps_per_s"],
+             result["optical_photons_per_s"], result["init_s"],
+             result["peak_rss_kb"], result["output_bytes_per_event"]))
+    return result
+
+
+def main():
+    source_dir = os.path.dirname(os.path.dirname(os.path.abspath(__file__)))
+    parser = argparse.ArgumentParser(description=__doc__.splitlines()[0])
+    parser.add_argument("--toymc", default="toyMC", help="toyMC executable")
+    parser.add_argument("--output", default="bench_results.jsonl",
+                        help="results file, one JSON line per invocation")
+    parser.add_argument("--workdir", default="bench_out",
+                        help="directory for the outputs and logs of the cases")
+    parser.add_argument("--seed", type=int, default=12345)
+    parser.add_argument("--threads", type=int, default=os.cpu_count())
+    parser.add_argument("--physics", default="qbbc",
+                        choices=["qbbc", "em4", "livermore"],
+                        help="physics list (toyMC -p)")
+    parser.add_argument("cases", nargs="*", default=CASES)
+    args = parser.parse_args()
+    args.workdir = os.path.abspath(args.workdir)
+
+    record = {
+        "commit": git_commit(source_dir),
+        "date": time.strftime("%Y-%m-%dT%H:%M:%S"),
+        "host": platform.node(),
+        "threads": args.threads,
+        "seed": args.seed,
+        "physics": args.physics,
+        "cases": [run_case(args, case, source_dir) for case in args.cases],
+    }
+    with open(args.output, "a") as f:
+        f.write(json.dumps(record) + "\n")
+    print("results appended to %s" % args.output)
+    return 0 if all("status" not in c for c in record["cases"]) else 1
+
+
+if __name__ == "__main__":
+    sys.exit(main())
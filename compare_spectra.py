@@ -0,0 +1,43 @@
+# coding=utf-8
+# Compare the per-event distributions of two toyMC outputs, e.g. the
+# validation runs of validate_prescale.mac, or an isotropic and a
+# direction-biased run (/toy/gun/biasFraction), using the event weights:
+#   python3 compare_spectra.py reference.root test.root [column]
+import sys
+import numpy as np
+import uproot
+
+def load(filename, column):
+    tree = uproot.open(filename)['event']
+    columns = [column, 'edep'] + (['weight'] if 'weight' in tree else [])
+    data = tree.arrays(columns, library='np')
+    # Only events with a deposit carry light
+    mask = data['edep'] > 0
+    x = data[column][mask]
+    w = data['weight'][mask] if 'weight' in data else np.ones(len(x))
+    return x, w
+
+ref_file, test_file = sys.argv[1], sys.argv[2]
+column = sys.argv[3] if len(sys.argv) > 3 else 'nPhotons'
+a, wa = load(ref_file, column)
+b, wb = load(test_file, column)
+print(f'{"":12s} {"events":>8s} {"mean":>10s} {"variance":>12s}')
+for name, x, w in ((ref_file, a, wa), (test_file, b, wb)):
+    mean = np.average(x, weights=w)
+    var = np.average((x - mean) ** 2, weights=w)
+    print(f'{name[-12:]:12s} {len(x):8d} {mean:10.3f} {var:12.3f}')
+
+# Binned chi2 between the two normalized distributions; the bin variances
+# are the sums of the squared weights
+hi = max(a.max(), b.max()) + 1
+edges = np.linspace(0, hi, min(int(hi), 100) + 1)
+ha, _ = np.histogram(a, edges, weights=wa)
+hb, _ = np.histogram(b, edges, weights=wb)
+va, _ = np.histogram(a, edges, weights=wa ** 2)
+vb, _ = np.histogram(b, edges, weights=wb ** 2)
+sa, sb = wa.sum(), wb.sum()
+mask = (va + vb) > 0
+chi2 = np.sum((ha[mask] / sa - hb[mask] / sb) ** 2
+              / (va[mask] / sa ** 2 + vb[mask] / sb ** 2))
+ndf = mask.sum() - 1
+print(f'chi2/ndf = {chi2:.1f}/{ndf}')
@@ -6,6 +6,8 @@
 #include "G4String.hh"
 #include "G4VUserActionInitialization.hh"
 
+#include <vector>
+
 /// Action initialization class.
 
 class ActionInitialization : public G4VUserActionInitialization
@@ -20,8 +22,17 @@ class ActionInitialization : public G4VUserActionInitialization
     {
       m_hDataFilename = hFilename;
     }
+    /// Seed from which the seed of every event is derived
+    void SetMasterSeed(G4long seed) { fMasterSeed = seed; }
+    /// Re-simulate only these event IDs of the job (see PrimaryGeneratorAction)
+    void SetReplayEvents(const std::vector<G4int>& eventIDs)
+    {
+      fReplayEvents = eventIDs;
+    }
   private:
     G4String m_hDataFilename = "ac.root"; //default out file
+    G4long fMasterSeed = 0;
+    std::vector<G4int> fReplayEvents;
 };
 
 #endif
@@ -0,0 +1,100 @@
+/// \file AsyncWriter.hh
+/// \brief Definition of the AsyncWriter and OutputBuffer classes
+
+#ifndef AsyncWriter_h
+#define AsyncWriter_h 1
+
+#include "RecordSink.hh"
+#include "globals.hh"
+
+#include <condition_variable>
+#include <deque>
+#include <mutex>
+#include <thread>
+
+class G4GenericMessenger;
+
+/// Output path that keeps I/O off the event loop.
+///
+/// Workers collect their records in an OutputBuffer, which holds two
+/// batches: while one is being filled the other may be queued or written
+/// by a dedicated writer thread. A worker only waits if its previous batch
+/// is still not written when the current one is full, so memory stays below
+/// 2 x threads x batch size, where the batch size is
+/// /toy/output/async/memoryCap / (2 x threads).
+///
+/// The writer is process-wide and created by the master; its settings are
+/// not broadcast:
+///   /toy/output/async/memoryCap    upper bound of the buffered records (MB)
+///   /toy/output/async/compression  ROOT compression setting (e.g. 505)
+///   /toy/output/async/basketSize   ROOT basket size in bytes
+
+class AsyncWriter
+{
+  public:
+    enum Format { kRoot, kColumnar };
+
+    static AsyncWriter* Instance();
+    ~AsyncWriter();
+
+    /// Master: create the sink and start the writer thread
+    G4bool Open(const G4String& fileName, G4int nThreads, Format format);
+    /// Master: write what is queued, stop the thread, close the sink.
+    /// The workers must have flushed their buffers.
+    void Close();
+    G4bool IsOpen() const { return fSink != 0; }
+
+    /// Bytes of records after which a worker hands its batch over
+    std::size_t GetBatchBytes() const { return fBatchBytes; }
+
+    G4int GetCompression() const { return fCompression; }
+    G4int GetBasketSize() const { return fBasketSize; }
+
+    // worker side
+    void Submit(OutputBatch* batch);
+    void WaitFor(OutputBatch* batch);
+
+  private:
+    AsyncWriter();
+    void Loop();
+
+    G4GenericMessenger* fMessenger;
+    G4double fMemoryCap;   // MB
+    G4int    fCompression;
+    G4int    fBasketSize;
+
+    RecordSink* fSink;
+    std::size_t fBatchBytes;
+    std::thread fThread;
+    std::mutex fMutex;
+    std::condition_variable fQueued;    // writer waits for batches
+    std::condition_variable fWritten;   // workers wait for their batch
+    std::deque<OutputBatch*> fQueue;
+    G4bool fStop;
+};
+
+//....oooOO0OOooo........oooOO0OOooo........oooOO0OOooo........oooOO0OOooo......
+
+/// Per-thread double buffer of the AsyncWriter
+
+class OutputBuffer
+{
+  public:
+    OutputBuffer();
+    ~OutputBuffer();
+
+    void Add(const EventRecord& record);
+    void Add(const StepRecord& record);
+    /// The records of an event are complete: batches only hold whole events
+    void EndEvent();
+    /// Hand over the current batch and wait until both are written
+    void Flush();
+
+  private:
+    OutputBatch fBatches[2];
+    G4int fCurrent;
+};
+
+//....oooOO0OOooo........oooOO0OOooo........oooOO0OOooo........oooOO0OOooo......
+
+#endif
@@ -0,0 +1,74 @@
+/// \file Checkpoint.hh
+/// \brief Definition of the Checkpoint class
+
+#ifndef Checkpoint_h
+#define Checkpoint_h 1
+
+#include "globals.hh"
+
+#include <vector>
+
+class G4GenericMessenger;
+
+/// Checkpointed runs.
+///
+///   /toy/checkpoint/interval 10000
+///   /toy/checkpoint/beamOn 1000000
+///
+/// processes the events in chunks of /toy/checkpoint/interval events, each
+/// chunk a run of its own written to a segment out/1.part<k>.root (with its
+/// .meta), so that the events of a completed chunk are on disk. After each
+/// chunk the state (seed, events requested and done, segments) is written
+/// atomically to out/1.ckpt.
+///
+/// Every event is seeded from the master seed, its run and its event ID.
+/// All chunks are seeded as the run of the first chunk (its run ID, kept in
+/// the checkpoint) and the events of chunk k carry the IDs from the first
+/// event of the chunk on, so the random state needs no saving: with toyMC --resume a killed job reads
+/// the seed from the checkpoint, skips the completed chunks and gives the
+/// same events as an uninterrupted job. toyMerge joins the segments.
+///
+/// The singleton is created by the master; its commands are not broadcast.
+
+class Checkpoint
+{
+  public:
+    static Checkpoint* Instance();
+    ~Checkpoint();
+
+    void SetMasterSeed(G4long seed) { fMasterSeed = seed; }
+    /// Read a checkpoint file; the next beamOn resumes from it
+    G4bool Load(const G4String& fileName);
+    G4long GetSeed() const { return fSeed; }
+
+    /// ID of the first event of the current run (0 outside checkpointed
+    /// runs); read by the workers while the master waits
+    G4int GetFirstEvent() const { return fFirstEvent; }
+    /// Run number of the event seeds of run runID: runID itself, or in a
+    /// checkpointed run the run ID of its first chunk
+    G4int GetSeedRun(G4int runID) const
+    { return ( fSeedRun >= 0 ) ? fSeedRun : runID; }
+
+  private:
+    Checkpoint();
+    void BeamOn(G4int nEvents);
+    void Save(const G4String& fileName) const;
+
+    G4int fInterval;
+    G4long fMasterSeed;
+    G4int fFirstEvent;
+    G4int fSeedRun;
+    G4GenericMessenger* fMessenger;
+
+    // state of the loaded or current checkpoint
+    G4bool fLoaded;
+    G4long fSeed;
+    G4int fRun;
+    G4int fEvents;
+    G4int fEventsDone;
+    std::vector<G4String> fSegments;
+};
+
+//....oooOO0OOooo........oooOO0OOooo........oooOO0OOooo........oooOO0OOooo......
+
+#endif
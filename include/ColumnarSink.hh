@@ -0,0 +1,68 @@
+/// \file ColumnarSink.hh
+/// \brief Definition of the ColumnarSink class
+
+#ifndef ColumnarSink_h
+#define ColumnarSink_h 1
+
+#include "RecordSink.hh"
+
+#include <cstddef>
+#include <fstream>
+#include <memory>
+#include <vector>
+
+/// Writes the records as plain binary columns, readable with mmap or
+/// numpy.memmap without ROOT (see read_columnar.py). For an output out/1
+/// the directory out/1.cols holds:
+///
+///   schema.json              tables, columns, dtypes and row counts
+///   event/<column>.bin       one fixed-width array per column
+///   step/<column>.bin
+///   index/step_begin.bin     int64, events+1 entries: the steps of event
+///                            row i are the step rows [begin[i], begin[i+1])
+///   index/event_row.bin      int64 (eventID, row) pairs of the written
+///                            events, sorted by eventID
+///
+/// Events from different threads are interleaved, so the index is how a
+/// single event, or its steps, is found without a scan: a binary search
+/// of event_row, then step_begin. event_row is built at Close from the
+/// eventID column on disk, its size follows the written events only.
+
+class ColumnarSink : public RecordSink
+{
+  public:
+    ColumnarSink();
+    virtual ~ColumnarSink();
+
+    virtual G4bool Open(const G4String& fileName);
+    virtual void Write(const OutputBatch& batch);
+    virtual void Close();
+
+    struct Column
+    {
+      const char* name;
+      const char* dtype;     // numpy type string without byte order
+      std::size_t offset;    // in the record
+      std::size_t size;
+      std::unique_ptr<std::ofstream> file;
+    };
+
+  private:
+    template <class Record>
+    void WriteColumns(std::vector<Column>& columns,
+                      const std::vector<Record>& records);
+    void WriteEventIndex() const;
+    void WriteSchema() const;
+
+    G4String fDirectory;
+    std::vector<Column> fEventColumns;
+    std::vector<Column> fStepColumns;
+    std::unique_ptr<std::ofstream> fStepBegin;
+    long long fEventRows;
+    long long fStepRows;
+    std::vector<char> fScratch;
+};
+
+//....oooOO0OOooo........oooOO0OOooo........oooOO0OOooo........oooOO0OOooo......
+
+#endif
@@ -9,10 +9,30 @@
 #include "G4NistManager.hh"
 #include "G4OpticalSurface.hh"
 
+#include <map>
+#include <utility>
+
 class G4VPhysicalVolume;
 class G4LogicalVolume;
+class G4GenericMessenger;
+class G4Box;
+class G4Tubs;
 
 /// Detector construction class to define materials and geometry.
+///
+/// The /toy/det/ commands change the scintillator size and material, the
+/// PMT (Detector) radius and its distance to the scintillator, and the
+/// reflectivity and efficiency of the scintillator surface. After
+/// initialization the solids and placements are modified in place, so only
+/// the geometry is re-optimized at the next run; a material change also
+/// updates the physics tables.
+///
+/// The Scintillator and the Detector form the region "Scintillator", the
+/// SourceCylinder the region "Source"; the World keeps the default region.
+/// Each region has its own production cuts, 0.7 mm until set from a macro:
+///   /run/setCut 1 cm                          World (default region)
+///   /run/setCutForRegion Source 1 cm
+///   /run/setCutForRegion Scintillator 0.7 mm
 
 class DetectorConstruction : public G4VUserDetectorConstruction
 {
@@ -21,13 +41,65 @@ class DetectorConstruction : public G4VUserDetectorConstruction
     virtual ~DetectorConstruction();
 
     virtual G4VPhysicalVolume* Construct();
+    virtual void ConstructSDandField();
     void DefineMaterial();
     //G4LogicalVolume* GetScoringVolume() const { return fScoringVolume; }
+
+    /// Photon detection efficiency of the Detector
+    G4double GetPDE() const { return fPDE; }
+    /// True if the PDE is applied to the scintillation yield instead of to
+    /// the photons reaching the Detector
+    G4bool GetYieldPrescale() const { return fYieldPrescale; }
+    /// True if optical photons in the Scintillator are transported by
+    /// OpticalBoxModel, which traces them in batches of GetFastBatchSize()
+    G4bool GetFastOptics() const { return fFastOptics; }
+    G4int GetFastBatchSize() const { return fFastBatchSize; }
+    G4double GetPMTGap() const { return fPMTGap; }
+    /// Set SCINTILLATIONYIELD and RESOLUTIONSCALE of the scintillators from
+    /// their nominal values and the prescale settings (master, between runs)
+    void UpdateScintillationYield() const;
+    /// Check the placements for overlaps (slow, meant for interactive use)
+    void SetCheckOverlaps(G4bool check) { fCheckOverlaps = check; }
+    /// Scintillator material, EJ200 or EJ276; can be changed between runs
+    void SetScintillatorMaterial(const G4String& name);
+    /// World material, Al or Air; can be changed between runs
+    void SetWorldMaterial(const G4String& name);
+    void SetScintillatorSize(G4double size);
+    void SetPMTRadius(G4double radius);
+    void SetPMTGap(G4double gap);
+    void SetSurfaceReflectivity(G4double reflectivity);
+    void SetSurfaceEfficiency(G4double efficiency);
     
   protected:
+    G4bool UpdateGeometry();
+    void DefineRegions(G4LogicalVolume* logicSource);
+    void SetSurfaceProperty(const G4String& name, G4double value);
+
     G4LogicalVolume*  fScoringVolume;
+    G4LogicalVolume*  fLogicWorld;
+    G4LogicalVolume*  fLogicScintillator;
+    G4LogicalVolume*  fLogicDetector;
     G4Material *Al,*Air,*Water,*Co60,*EJ200,*EJ276;
     G4OpticalSurface* stickToAir;
+
+    G4double fPDE;
+    G4bool   fYieldPrescale;
+    G4bool   fFastOptics;
+    G4int    fFastBatchSize;
+    G4bool   fCheckOverlaps;
+    G4Material* fWorldMaterial;
+    G4Material* fScintMaterial;
+    G4double fScintSize;
+    G4double fPMTRadius;
+    G4double fPMTGap;     // between the scintillator and the Detector face
+    G4Box*   fSolidScintillator;
+    G4Tubs*  fSolidDetector;
+    G4VPhysicalVolume* fPhysSource;
+    G4VPhysicalVolume* fPhysDetector;
+    // nominal (yield, resolution scale) of each scintillator
+    std::map<G4Material*, std::pair<G4double, G4double> > fNominalYield;
+    G4GenericMessenger* fMessenger;
+    G4GenericMessenger* fDetMessenger;
 };
 
 //....oooOO0OOooo........oooOO0OOooo........oooOO0OOooo........oooOO0OOooo......
@@ -0,0 +1,91 @@
+/// \file DetectorHit.hh
+/// \brief Definition of the DetectorHit class
+
+#ifndef DetectorHit_h
+#define DetectorHit_h 1
+
+#include "G4VHit.hh"
+#include "G4THitsCollection.hh"
+#include "G4Allocator.hh"
+#include "G4ThreeVector.hh"
+#include "globals.hh"
+
+class G4ParticleDefinition;
+
+/// Detector hit class
+///
+/// One hit per step in the Detector volume. Positions and energies are kept
+/// in single precision and the particle as a definition pointer, so a hit is
+/// a few dozen bytes and is recycled through a thread-local G4Allocator.
+
+class DetectorHit : public G4VHit
+{
+  public:
+    DetectorHit();
+    virtual ~DetectorHit();
+
+    inline void* operator new(size_t);
+    inline void  operator delete(void*);
+
+    // set methods
+    void SetParticle(const G4ParticleDefinition* particle) { fParticle = particle; }
+    void SetTrackID(G4int id)       { fTrackID = id; }
+    void SetParentID(G4int id)      { fParentID = id; }
+    void SetEnergy(G4double e)      { fEnergy = e; }
+    void SetEdep(G4double de)       { fEdep = de; }
+    void SetTime(G4double t)        { fTime = t; }
+    void SetEntering(G4bool flag)   { fEntering = flag; }
+    void SetPrePos(const G4ThreeVector& pos)
+      { fPrePos[0] = pos.x(); fPrePos[1] = pos.y(); fPrePos[2] = pos.z(); }
+    void SetPostPos(const G4ThreeVector& pos)
+      { fPostPos[0] = pos.x(); fPostPos[1] = pos.y(); fPostPos[2] = pos.z(); }
+
+    // get methods
+    const G4ParticleDefinition* GetParticle() const { return fParticle; }
+    G4int    GetTrackID() const  { return fTrackID; }
+    G4int    GetParentID() const { return fParentID; }
+    G4double GetEnergy() const   { return fEnergy; }
+    G4double GetEdep() const     { return fEdep; }
+    G4double GetTime() const     { return fTime; }
+    G4bool   IsEntering() const  { return fEntering; }
+    G4ThreeVector GetPrePos() const
+      { return G4ThreeVector(fPrePos[0], fPrePos[1], fPrePos[2]); }
+    G4ThreeVector GetPostPos() const
+      { return G4ThreeVector(fPostPos[0], fPostPos[1], fPostPos[2]); }
+
+  private:
+    const G4ParticleDefinition* fParticle;
+    G4int   fTrackID;
+    G4int   fParentID;
+    G4float fEnergy;      // kinetic energy at the pre-step point
+    G4float fEdep;
+    G4float fTime;        // global time at the pre-step point
+    G4float fPrePos[3];
+    G4float fPostPos[3];
+    G4bool  fEntering;    // pre-step point on the volume boundary
+};
+
+//....oooOO0OOooo........oooOO0OOooo........oooOO0OOooo........oooOO0OOooo......
+
+typedef G4THitsCollection<DetectorHit> DetectorHitsCollection;
+
+extern G4ThreadLocal G4Allocator<DetectorHit>* DetectorHitAllocator;
+
+//....oooOO0OOooo........oooOO0OOooo........oooOO0OOooo........oooOO0OOooo......
+
+inline void* DetectorHit::operator new(size_t)
+{
+  if ( ! DetectorHitAllocator ) DetectorHitAllocator = new G4Allocator<DetectorHit>;
+  return (void *) DetectorHitAllocator->MallocSingle();
+}
+
+//....oooOO0OOooo........oooOO0OOooo........oooOO0OOooo........oooOO0OOooo......
+
+inline void DetectorHit::operator delete(void* hit)
+{
+  DetectorHitAllocator->FreeSingle((DetectorHit*) hit);
+}
+
+//....oooOO0OOooo........oooOO0OOooo........oooOO0OOooo........oooOO0OOooo......
+
+#endif
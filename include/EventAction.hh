@@ -5,12 +5,18 @@
 #define EventAction_h 1
 
 #include "G4UserEventAction.hh"
+#include "EventRecord.hh"
 #include "globals.hh"
 
+#include <vector>
+
 class RunAction;
+class G4ParticleDefinition;
 
 /// Event action class
 ///
+/// Reduces the hits collections of the event to an EventRecord and fills
+/// the output ntuples once per event, if it passes the Trigger.
 
 class EventAction : public G4UserEventAction
 {
@@ -21,8 +27,21 @@ class EventAction : public G4UserEventAction
     virtual void BeginOfEventAction(const G4Event* event);
     virtual void EndOfEventAction(const G4Event* event);
 
+    /// Called by SteppingAction for every step, for Telemetry
+    void CountStep() { ++fNSteps; }
+    void CountPhoton() { ++fNPhotons; }
+
   private:
+    void FillStepNtuple(const G4Event* event) const;
+
     RunAction* fRunAction;
+    G4int      fDetectorHCID;
+    G4int      fScintillatorHCID;
+    const G4ParticleDefinition* fOpticalPhoton;
+    EventRecord fRecord;
+    std::vector<G4double> fPhotonTimes;  // detected photon arrival times
+    G4long     fNSteps;
+    G4long     fNPhotons;   // optical photons stacked
 };
 
 //....oooOO0OOooo........oooOO0OOooo........oooOO0OOooo........oooOO0OOooo......
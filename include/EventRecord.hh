@@ -0,0 +1,40 @@
+/// \file EventRecord.hh
+/// \brief Definition of the EventRecord structure
+
+#ifndef EventRecord_h
+#define EventRecord_h 1
+
+#include "globals.hh"
+
+/// Per-event summary, one row of the "event" ntuple, and one step in the
+/// Detector, one row of the "step" ntuple.
+/// Energies are in keV, times in ns and lengths in mm.
+
+struct EventRecord
+{
+  G4int   eventID = -1;
+  G4int   nPhotons = 0;        // optical photons entering the Detector
+  G4float firstTime = 0.;      // arrival time of the first photon
+  G4float meanTime = 0.;       // mean photon arrival time
+  G4float edep = 0.;           // total deposit in the scintillator
+  G4float primaryEnergy = 0.;  // summed kinetic energy of the primaries
+  G4int   primaryPDG = 0;      // PDG code of the first primary
+  G4float qTotal = 0.;         // PMT charge integrals (PMTDigitizer), in
+  G4float qTail = 0.;          // photoelectrons; 0 without digitization
+  G4float weight = 1.;         // product of the primary weights
+};
+
+struct StepRecord
+{
+  G4float energy = 0.;         // kinetic energy at the pre-step point
+  G4float pre[3] = {0., 0., 0.};
+  G4float post[3] = {0., 0., 0.};
+  G4int   pdg = 0;
+  G4int   eventID = -1;
+  G4int   trackID = 0;
+  G4int   parentID = 0;
+  G4float edep = 0.;
+  G4float weight = 1.;         // weight of the event
+};
+
+#endif
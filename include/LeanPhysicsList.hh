@@ -0,0 +1,25 @@
+/// \file LeanPhysicsList.hh
+/// \brief Definition of the LeanPhysicsList class
+
+#ifndef LeanPhysicsList_h
+#define LeanPhysicsList_h 1
+
+#include "G4VModularPhysicsList.hh"
+#include "globals.hh"
+
+/// Electromagnetic and decay physics only, for the gamma source runs: no
+/// hadronic constructors, whose tables dominate the start-up time and memory
+/// of QBBC. The EM constructor is G4EmStandardPhysics_option4 ("em4") or
+/// G4EmLivermorePhysics ("livermore"). Optical physics is registered by the
+/// caller, as for QBBC. Neutron studies (EJ276) need QBBC.
+
+class LeanPhysicsList : public G4VModularPhysicsList
+{
+  public:
+    explicit LeanPhysicsList(const G4String& emName);
+    virtual ~LeanPhysicsList();
+};
+
+//....oooOO0OOooo........oooOO0OOooo........oooOO0OOooo........oooOO0OOooo......
+
+#endif
@@ -0,0 +1,116 @@
+/// \file LightMap.hh
+/// \brief Definition of the LightMap class
+
+#ifndef LightMap_h
+#define LightMap_h 1
+
+#include "G4VAccumulable.hh"
+#include "G4ThreeVector.hh"
+#include "globals.hh"
+
+#include <vector>
+
+class G4GenericMessenger;
+class G4Material;
+class G4VPhysicalVolume;
+
+/// Light-collection efficiency map of the scintillator.
+///
+/// The scintillator bounding box is divided into voxels; for each voxel the
+/// map holds the probability that an optical photon emitted there reaches
+/// the Detector and the distribution of its arrival time after emission.
+/// Arrival times beyond /toy/lightmap/timeMax (photons trapped by total
+/// internal reflection) go to an overflow bin, which keeps their mean
+/// excess over timeMax; fast mode samples them from an exponential tail.
+///
+/// Modes (/toy/lightmap/mode):
+///  - off:       full optical tracking, the map is not used
+///  - calibrate: every event is a burst of optical photons from one point
+///               (see lightmap_calib.mac); the map is accumulated over the
+///               run, merged across threads and saved at the end of run
+///  - fast:      the map is loaded at the start of run and detected photons
+///               are sampled from the deposits of each charged step; optical
+///               photon generation is switched off
+
+class LightMap : public G4VAccumulable
+{
+  public:
+    enum Mode { kOff, kCalibrate, kFast };
+
+    LightMap();
+    virtual ~LightMap();
+
+    // methods from base class
+    virtual void Merge(const G4VAccumulable& other);
+    virtual void Reset();
+
+    Mode GetMode() const { return fMode; }
+    const G4String& GetFileName() const { return fFileName; }
+
+    /// Set the box covered by the map from the scintillator placement; a
+    /// loaded map keeps its own box, which must be the scintillator's
+    void SetVolume(const G4VPhysicalVolume* volume);
+    /// Take yield and decay times from the scintillator material
+    void SetMaterial(const G4Material* material);
+
+    // calibration
+    void Fill(const G4ThreeVector& pos, G4int nEmitted,
+              const std::vector<G4double>& arrivalTimes);
+    void Save(const G4String& fileName) const;
+
+    // fast mode
+    G4bool Load(const G4String& fileName);
+    G4bool IsLoaded() const { return fLoaded; }
+    /// Append the arrival times of the photons detected from a deposit
+    /// edep at pos and time t0
+    void SamplePhotons(const G4ThreeVector& pos, G4double edep, G4double t0,
+                       std::vector<G4double>& arrivalTimes) const;
+
+  private:
+    void SetMode(const G4String& mode);
+    void SetNVoxels(G4int n);
+    void SetNTimeBins(G4int nbins);
+    void SetTimeMax(G4double tmax);
+    void SetVoxels(G4int nx, G4int ny, G4int nz);
+    void SetTimeBins(G4int nbins, G4double tmax);
+    void Book();
+    G4int Voxel(const G4ThreeVector& pos) const;
+    /// Fatal exception if the map box is not the scintillator box
+    void CheckBox(const char* origin) const;
+
+    Mode     fMode;
+    G4String fFileName;
+    G4GenericMessenger* fMessenger;
+
+    // grid
+    G4int fNx, fNy, fNz;
+    G4ThreeVector fMin, fMax;
+    // current scintillator box
+    G4bool fHasBox;
+    G4ThreeVector fBoxMin, fBoxMax;
+    G4int    fNtBins;
+    G4double fTmax;
+
+    // accumulated per voxel
+    std::vector<G4double> fEmitted;
+    std::vector<G4double> fDetected;
+    std::vector<G4double> fTimeHist;   // fNtBins per voxel
+    std::vector<G4double> fOverflow;   // photons arriving after fTmax
+    std::vector<G4double> fOverflowTime;   // sum of their t - fTmax
+
+    // sampling tables, built by Load()
+    G4bool fLoaded;
+    std::vector<G4double> fProbability;
+    std::vector<G4double> fTimeCdf;    // fNtBins + 1 (overflow) per voxel
+    std::vector<G4double> fOverflowMean;   // mean t - fTmax of the overflow
+
+    // scintillator properties
+    G4double fYield;
+    G4double fFastTime;
+    G4double fSlowTime;
+    G4double fYieldRatio;
+};
+
+//....oooOO0OOooo........oooOO0OOooo........oooOO0OOooo........oooOO0OOooo......
+
+#endif
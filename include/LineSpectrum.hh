@@ -0,0 +1,53 @@
+/// \file LineSpectrum.hh
+/// \brief Definition of the LineSpectrum class
+
+#ifndef LineSpectrum_h
+#define LineSpectrum_h 1
+
+#include "globals.hh"
+
+#include <vector>
+
+/// Discrete (line) spectrum read from a text file such as Co60_spectrum.txt:
+///
+///   Co60 Spectrum        title
+///   MeV                  energy unit
+///   1.1732 1             energy and intensity (emissions per decay)
+///   1.3325 1
+///
+/// Lines starting with # are ignored. Sample() draws one line with
+/// probability proportional to its intensity in constant time, using
+/// Walker's alias method.
+
+class LineSpectrum
+{
+  public:
+    LineSpectrum();
+    ~LineSpectrum();
+
+    /// Read the file and build the alias table; false if it cannot be read
+    G4bool Load(const G4String& fileName);
+    G4bool IsLoaded() const { return ! fEnergies.empty(); }
+
+    const G4String& GetTitle() const { return fTitle; }
+    std::size_t GetNumberOfLines() const { return fEnergies.size(); }
+    G4double GetEnergy(std::size_t i) const { return fEnergies[i]; }
+    G4double GetIntensity(std::size_t i) const { return fIntensities[i]; }
+
+    /// Energy of one line, drawn according to the intensities
+    G4double Sample() const;
+
+  private:
+    void BuildAliasTable();
+
+    G4String fTitle;
+    std::vector<G4double> fEnergies;
+    std::vector<G4double> fIntensities;
+    // alias table: line i is kept with probability fKeep[i], else fAlias[i]
+    std::vector<G4double> fKeep;
+    std::vector<std::size_t> fAlias;
+};
+
+//....oooOO0OOooo........oooOO0OOooo........oooOO0OOooo........oooOO0OOooo......
+
+#endif
@@ -0,0 +1,157 @@
+/// \file OpticalBoxModel.hh
+/// \brief Definition of the OpticalBoxModel class
+
+#ifndef OpticalBoxModel_h
+#define OpticalBoxModel_h 1
+
+#include "G4VFastSimulationModel.hh"
+#include "G4VUserTrackInformation.hh"
+#include "G4AffineTransform.hh"
+#include "G4MaterialPropertyVector.hh"
+#include "globals.hh"
+
+#include <vector>
+
+class DetectorConstruction;
+class G4LogicalVolume;
+class G4ParticleDefinition;
+class G4Track;
+class G4VPhysicalVolume;
+class G4VSolid;
+
+/// Fast optical photon transport in the scintillator box
+/// (/toy/optics/fastBox true).
+///
+/// Optical photons in the Scintillator volume are not tracked by Geant4:
+/// they are killed and collected, in the local frame of the box, into a
+/// structure-of-arrays batch. A batch is traced analytically when it holds
+/// /toy/optics/fastBatch photons and when the last track of the event is
+/// done (TrackingAction). Each pass over the batch
+///  - samples the absorption length (ABSLENGTH) of every photon,
+///  - moves all photons to the nearest wall or absorption point,
+///  - applies the boundary process of the wall to the survivors, as
+///    G4OpBoundaryProcess does for a polished dielectric_dielectric surface:
+///    killed if the volume outside has no RINDEX, absorbed with probability
+///    1 - REFLECTIVITY - TRANSMITTANCE, else Fresnel reflection, total
+///    internal reflection or refraction with the photon polarization,
+///  - and compacts the photons still inside to the front of the arrays.
+/// The free path and boundary steps are branch-free loops over the arrays
+/// (every outcome is computed and the one that applies is selected),
+/// marked for vectorization and built with -O3 -fopenmp-simd.
+/// Photons refracted out of the box are handed back to Geant4 as new tracks
+/// just outside the wall, so the Detector sees them as with full tracking.
+///
+/// The box must be a G4Box placed in the world, with an optional polished
+/// dielectric_dielectric border or skin surface; otherwise the model warns
+/// once and leaves the photons to Geant4. Other world daughters may touch
+/// the box, except sensitive ones: on the patch of wall they cover, photons
+/// see the material of that volume and the surface Geant4 would pick
+/// there (none: reflectivity 1) instead of the world.
+
+class OpticalBoxModel : public G4VFastSimulationModel
+{
+  public:
+    /// Marks the tracks made by the model
+    class HandedBack : public G4VUserTrackInformation
+    {
+      public:
+        virtual void Print() const {}
+    };
+
+    OpticalBoxModel(G4Region* envelope, G4LogicalVolume* box,
+                    const DetectorConstruction* detector);
+    virtual ~OpticalBoxModel();
+
+    // methods from base class
+    virtual G4bool IsApplicable(const G4ParticleDefinition& particle);
+    virtual G4bool ModelTrigger(const G4FastTrack& fastTrack);
+    virtual void DoIt(const G4FastTrack& fastTrack, G4FastStep& fastStep);
+
+    /// Model of the calling thread, 0 if none was built
+    static OpticalBoxModel* GetInstance() { return fInstance; }
+    /// True for the photons the model handed back to Geant4, which were
+    /// already stacked (and counted) once as scintillation photons
+    static G4bool IsHandedBack(const G4Track* track);
+    std::size_t GetBatchSize() const { return fBatch.Size(); }
+    /// Trace the collected photons and stack those that leave the box
+    void TraceBatch();
+    /// Drop the collected photons (aborted or new event)
+    void ClearBatch() { fBatch.Resize(0); }
+
+  private:
+    enum Fate { kInside, kKilled, kLeaving };
+
+    /// Photons of a batch, one array per component, in the box frame
+    struct PhotonBatch
+    {
+      std::vector<G4double> x, y, z;      // position
+      std::vector<G4double> u, v, w;      // direction
+      std::vector<G4double> px, py, pz;   // polarization
+      std::vector<G4double> time, energy, weight;
+      std::vector<G4int>    parentID;
+      std::vector<G4double> invSpeed;       // 1/group velocity
+      // optical constants at the photon energy
+      std::vector<G4double> rindex, absLength, reflectivity, transmittance;
+      std::vector<G4double> outsideRindex;   // < 0: no RINDEX outside
+      // scratch of a pass
+      std::vector<G4double> absStep, wallStep;
+      std::vector<G4int>    wall;           // +-(axis + 1) of the wall hit
+      std::vector<G4double> surfaceRand, fresnelRand;
+      std::vector<G4double> fate;   // a Fate, as wide as the other lanes
+      // optical constants of the wall hit in a pass, with contacts
+      std::vector<G4double> wallReflectivity, wallTransmittance, wallRindex;
+
+      std::size_t Size() const { return x.size(); }
+      void Resize(std::size_t n);
+      void Move(std::size_t from, std::size_t to);
+    };
+
+    /// A world daughter touching the box
+    struct Contact
+    {
+      const G4VSolid* solid;
+      G4AffineTransform toLocal;    // box frame -> its frame
+      G4MaterialPropertyVector* rindex;
+      G4MaterialPropertyVector* reflectivity;
+      G4MaterialPropertyVector* transmittance;
+    };
+
+    G4bool Setup(const G4FastTrack& fastTrack);
+    /// Surface between the box and a volume outside it, as picked by
+    /// G4OpBoundaryProcess; false if it is not modelled
+    G4bool FindSurface(const G4VPhysicalVolume* boxVolume,
+                       const G4VPhysicalVolume* outside,
+                       G4MaterialPropertyVector*& reflectivity,
+                       G4MaterialPropertyVector*& transmittance);
+    void Warn(const G4String& reason);
+    /// Optical constants of the wall hit by the first n photons
+    void ContactPatches(std::size_t n);
+    /// Boundary process for the first n photons, all on a wall
+    void Boundary(std::size_t n);
+    G4Track* MakeTrack(std::size_t i) const;
+
+    static G4ThreadLocal OpticalBoxModel* fInstance;
+
+    G4LogicalVolume* fBox;
+    const DetectorConstruction* fDetector;
+    const G4ParticleDefinition* fOpticalPhoton;
+    G4bool fSupported;
+    G4bool fWarned;
+
+    // set up from the first photon of a batch
+    G4double fHalf[3];
+    G4AffineTransform fToGlobal;
+    G4MaterialPropertyVector* fRindex;
+    G4MaterialPropertyVector* fGroupVelocity;
+    G4MaterialPropertyVector* fAbsLength;
+    G4MaterialPropertyVector* fReflectivity;
+    G4MaterialPropertyVector* fTransmittance;
+    G4MaterialPropertyVector* fOutsideRindex;
+    std::vector<Contact> fContacts;
+
+    PhotonBatch fBatch;
+};
+
+//....oooOO0OOooo........oooOO0OOooo........oooOO0OOooo........oooOO0OOooo......
+
+#endif
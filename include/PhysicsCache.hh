@@ -0,0 +1,59 @@
+/// \file PhysicsCache.hh
+/// \brief Definition of the PhysicsCache class
+
+#ifndef PhysicsCache_h
+#define PhysicsCache_h 1
+
+#include "G4VStateDependent.hh"
+#include "globals.hh"
+
+class G4VUserPhysicsList;
+
+/// Physics table cache (toyMC -c directory).
+///
+/// The tables depend on the physics list and its processes, the materials
+/// and where they are placed, and the production cuts of every region. All
+/// of these are written to a key, and the tables of a key are kept in their
+/// own subdirectory, <list>-<hash of the key>, with the key in its stamp
+/// file toyMC.tables.
+///
+/// The key is only complete once the geometry is built and the macro has
+/// set the cuts, so the cache is looked up when the first run starts
+/// (Idle -> Init, just before the tables are built) and the tables are
+/// read back only if the stamp holds the same key. After the job the tables
+/// of the last run are stored if the cache has none for its key: they are
+/// written to a temporary directory next to the others, which is renamed
+/// into place, so that jobs sharing the cache never see a partial
+/// directory; the job that loses the rename drops its copy.
+///
+/// Created by the master, which builds the tables.
+
+class PhysicsCache : public G4VStateDependent
+{
+  public:
+    PhysicsCache(const G4String& directory, const G4String& physics,
+                 G4VUserPhysicsList* physicsList);
+    virtual ~PhysicsCache();
+
+    virtual G4bool Notify(G4ApplicationState requestedState);
+
+    /// Store the tables of the last run unless they were read from the
+    /// cache or the cache already has them
+    void Store();
+
+  private:
+    G4String Key() const;
+    G4String Subdirectory(const G4String& key) const;
+    static G4bool ReadStamp(const G4String& directory, G4String& key);
+    static void Remove(const G4String& directory);
+
+    G4String fDirectory;
+    G4String fPhysics;
+    G4VUserPhysicsList* fPhysicsList;
+    G4bool fLookedUp;     // the first run has started
+    G4bool fRetrieved;    // its tables are read from the cache
+};
+
+//....oooOO0OOooo........oooOO0OOooo........oooOO0OOooo........oooOO0OOooo......
+
+#endif
@@ -7,24 +7,98 @@
 #include "G4VUserPrimaryGeneratorAction.hh"
 #include "G4ParticleGun.hh"
 #include "G4GeneralParticleSource.hh"
+#include "G4ThreeVector.hh"
+#include "LineSpectrum.hh"
 #include "globals.hh"
 
+#include <vector>
+
 class G4ParticleGun;
 class G4Event;
 class G4Box;
+class G4GenericMessenger;
+class G4ParticleDefinition;
+class G4VPhysicalVolume;
+class ResponseMatrix;
+
+/// Primary generator action class
+///
+/// Generators (/toy/gun/mode):
+///  - gps:     G4GeneralParticleSource, configured with /gps/ commands
+///  - cascade: one decay per event; every line of the spectrum file
+///             (/toy/gun/spectrum) is emitted with probability equal to its
+///             intensity (capped at 1), so Co-60 gives both gammas
+///  - lines:   one gamma per event, its line drawn according to the
+///             intensities
+/// The cascade and lines generators emit isotropic gammas from a point
+/// uniformly distributed in the SourceCylinder volume. In response-matrix
+/// mode (/toy/response/enable true) every event is instead one such gamma
+/// with the energy of its grid point (ResponseMatrix::GetEnergy).
+///
+/// Direction biasing (/toy/gun/biasFraction f, cascade and lines only): a
+/// fraction f of the gammas is emitted in the smallest cone around the inward
+/// normal of the Scintillator face in front of the vertex that contains the
+/// box (the half-space towards the box for a vertex on the face plane), the
+/// others isotropically; a vertex inside the box is not biased.
+/// Each gamma gets the weight (isotropic density)/(sampled density), i.e.
+/// 1/(1 - f + f/c) in the cone, whose solid angle is the fraction c of 4 pi,
+/// and 1/(1 - f) outside; EventAction weights the event by the product of
+/// the primary weights. f is kept below 1, so that the gammas that reach the
+/// scintillator only after scattering elsewhere are still sampled and every
+/// weight stays finite. GPS biasing (/gps/hist/type bias...) weights the
+/// primaries the same way.
+///
+/// Before generating an event the random engine is reseeded from the master
+/// seed, the run ID (Checkpoint::GetSeedRun) and the event ID, so that every
+/// event can be reproduced on its own, whatever the thread that processes
+/// it, and the runs of a job are independent samples.
+/// With a replay list, event i of the run is re-simulated as event
+/// replay[i] of the original job, with tracking verbose on; events beyond the
+/// list are left empty and the run is aborted.
+/// In a chunk of a checkpointed run (Checkpoint) the event IDs are shifted by
+/// the first event of the chunk.
 
 class PrimaryGeneratorAction : public G4VUserPrimaryGeneratorAction
 {
   public:
-    PrimaryGeneratorAction();    
+    enum Mode { kGPS, kCascade, kLines };
+
+    PrimaryGeneratorAction(G4long masterSeed,
+                           const std::vector<G4int>& replayEvents);
     virtual ~PrimaryGeneratorAction();
 
     // method from the base class
     virtual void GeneratePrimaries(G4Event*);     
     const G4GeneralParticleSource* GetParticleGun() const {return fParticleGun;}
+    void SetResponseMatrix(const ResponseMatrix* matrix) { fResponseMatrix = matrix; }
+
+    /// Seed the random engine for event eventID of run runID of a job
+    static void SeedEvent(G4long masterSeed, G4int runID, G4int eventID);
   
   private:
+    void SetMode(const G4String& mode);
+    void SetSpectrumFile(const G4String& fileName);
+    void GenerateDecay(G4Event* event);
+    void GenerateGridPoint(G4Event* event);
+    G4ThreeVector SamplePosition();
+    G4ThreeVector SampleDirection() const;
+    /// Isotropic or biased direction from position, and its weight
+    G4ThreeVector SampleDirection(const G4ThreeVector& position,
+                                  G4double& weight);
+
     G4GeneralParticleSource* fParticleGun;
+    G4long fMasterSeed;
+    std::vector<G4int> fReplayEvents;
+
+    Mode fMode;
+    G4String fSpectrumFile;
+    LineSpectrum fSpectrum;
+    const G4ParticleDefinition* fGamma;
+    const G4VPhysicalVolume* fSource;
+    const G4VPhysicalVolume* fScintillator;
+    G4double fBiasFraction;
+    const ResponseMatrix* fResponseMatrix;
+    G4GenericMessenger* fMessenger;
 };
 
 //....oooOO0OOooo........oooOO0OOooo........oooOO0OOooo........oooOO0OOooo......
@@ -0,0 +1,43 @@
+/// \file RecordSink.hh
+/// \brief Definition of the OutputBatch structure and the RecordSink class
+
+#ifndef RecordSink_h
+#define RecordSink_h 1
+
+#include "EventRecord.hh"
+#include "globals.hh"
+
+#include <vector>
+
+/// Records of one worker handed to the AsyncWriter in one go. A batch holds
+/// whole events; the steps of an event follow those of the previous event.
+struct OutputBatch
+{
+  std::vector<EventRecord> events;
+  std::vector<StepRecord>  steps;
+  G4bool pending = false;   // queued or being written
+
+  std::size_t Bytes() const
+  {
+    return events.size()*sizeof(EventRecord) + steps.size()*sizeof(StepRecord);
+  }
+};
+
+/// Output format of the AsyncWriter. Open() is called before the writer
+/// thread starts, Write() from the writer thread and Close() after it has
+/// stopped, so a sink is never used by two threads at once.
+
+class RecordSink
+{
+  public:
+    virtual ~RecordSink() {}
+
+    /// Create the output; false if it cannot be written
+    virtual G4bool Open(const G4String& fileName) = 0;
+    virtual void Write(const OutputBatch& batch) = 0;
+    virtual void Close() = 0;
+};
+
+//....oooOO0OOooo........oooOO0OOooo........oooOO0OOooo........oooOO0OOooo......
+
+#endif
@@ -0,0 +1,72 @@
+/// \file ResponseMatrix.hh
+/// \brief Definition of the ResponseMatrix class
+
+#ifndef ResponseMatrix_h
+#define ResponseMatrix_h 1
+
+#include "G4VAccumulable.hh"
+#include "globals.hh"
+
+#include <vector>
+
+class G4GenericMessenger;
+
+/// Detector response matrix: detected photons versus true gamma energy.
+///
+/// With /toy/response/enable true the generator emits one mono-energetic
+/// gamma per event from the source volume. Event i takes point i modulo n
+/// of the energy grid (n points), so a /run/beamOn of k*n events gives
+/// every energy k events, spread over all worker threads. The grid is set
+/// with
+///   /toy/response/energies 100 200 662 1173 1332 keV
+///   /toy/response/grid 20 50 2000 keV      (20 points, linear)
+/// The detected photons of each event are counted in /toy/response/photonBins
+/// bins up to /toy/response/photonMax, plus an overflow bin, and weighted by
+/// the event weight. The matrix is merged across threads and the master
+/// saves it to /toy/response/file (default <output>.response) at the end
+/// of the run. The photons only reach the Detector through a World material
+/// with a RINDEX; RunAction warns when the World has none.
+
+class ResponseMatrix : public G4VAccumulable
+{
+  public:
+    ResponseMatrix();
+    virtual ~ResponseMatrix();
+
+    // methods from base class
+    virtual void Merge(const G4VAccumulable& other);
+    virtual void Reset();
+
+    G4bool IsEnabled() const { return fEnabled && ! fEnergies.empty(); }
+    const G4String& GetFileName() const { return fFileName; }
+
+    /// Grid energy of event eventID
+    G4double GetEnergy(G4int eventID) const
+    { return fEnergies[eventID % fEnergies.size()]; }
+    /// Count the detected photons of event eventID
+    void Fill(G4int eventID, G4int nPhotons, G4double weight);
+    void Save(const G4String& fileName) const;
+
+  private:
+    void SetEnergies(const G4String& list);
+    void SetGrid(const G4String& grid);
+    void SetPhotonBins(G4int nbins);
+    void SetPhotonMax(G4int max);
+    void Book();
+
+    G4bool   fEnabled;
+    G4String fFileName;
+    G4GenericMessenger* fMessenger;
+
+    std::vector<G4double> fEnergies;
+    G4int fNPhotonBins;
+    G4int fPhotonMax;
+
+    // accumulated per energy
+    std::vector<G4double> fEvents;   // sum of event weights
+    std::vector<G4double> fCounts;   // fNPhotonBins + 1 (overflow) per energy
+};
+
+//....oooOO0OOooo........oooOO0OOooo........oooOO0OOooo........oooOO0OOooo......
+
+#endif
@@ -0,0 +1,40 @@
+/// \file RootSink.hh
+/// \brief Definition of the RootSink class
+
+#ifndef RootSink_h
+#define RootSink_h 1
+
+#include "RecordSink.hh"
+
+class TFile;
+class TTree;
+
+/// Writes the records as the "event" and "step" TTrees of a ROOT file, with
+/// the branch names of the G4AnalysisManager ntuples, so that toyMerge and
+/// the analysis scripts read both outputs alike. Only built with ROOT
+/// (TOYMC_WITH_ROOT).
+
+class RootSink : public RecordSink
+{
+  public:
+    RootSink(G4int compression, G4int basketSize);
+    virtual ~RootSink();
+
+    virtual G4bool Open(const G4String& fileName);
+    virtual void Write(const OutputBatch& batch);
+    virtual void Close();
+
+  private:
+    G4int fCompression;
+    G4int fBasketSize;
+    TFile* fFile;
+    TTree* fEventTree;
+    TTree* fStepTree;
+    // branch buffers
+    EventRecord fEvent;
+    StepRecord  fStep;
+};
+
+//....oooOO0OOooo........oooOO0OOooo........oooOO0OOooo........oooOO0OOooo......
+
+#endif
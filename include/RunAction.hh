@@ -9,10 +9,47 @@
 #include "globals.hh"
 
 class G4Run;
+class G4GenericMessenger;
+class LightMap;
+class StepProfile;
+class PMTDigitizer;
+class Trigger;
+class ResponseMatrix;
+class OutputBuffer;
+
+/// Run action class
+///
+/// Books the output ntuples:
+///  - "event": one row per event (EventRecord), not in "hist" output mode
+///  - "step":  one row per step in the Detector, only in "step" output mode
+/// and the spectra, filled in every mode and merged across threads:
+///  - H1 "edep" (keV), "nPhotons", "arrivalTime" (ns, one entry per photon)
+///  - H2 "nPhotonsVsEdep"
+/// With /toy/output/writer async the ntuple records go through the
+/// AsyncWriter to the output file instead, and the histograms are written by
+/// G4AnalysisManager to <output>.hist.root.
+/// /toy/output/format columnar writes the records as memory-mappable binary
+/// columns to <output>.cols instead (see ColumnarSink); it always uses the
+/// AsyncWriter. Only the events passing the Trigger (/toy/trigger/) get
+/// ntuple rows or records. In response-matrix mode (/toy/response/) the
+/// master also saves the merged ResponseMatrix at the end of run.
 
 class RunAction : public G4UserRunAction
 {
   public:
+    enum OutputMode { kEventOutput, kStepOutput, kHistOutput };
+    enum WriterMode { kG4Writer, kAsyncWriter };
+    enum OutputFormat { kRootFormat, kColumnarFormat };
+
+    // ntuple ids
+    static const G4int kEventNtuple = 0;
+    static const G4int kStepNtuple = 1;
+    // histogram ids
+    static const G4int kEdepH1 = 0;
+    static const G4int kNPhotonsH1 = 1;
+    static const G4int kTimeH1 = 2;
+    static const G4int kNPhotonsEdepH2 = 0;
+
     RunAction();
     ~RunAction();// override = default;
 
@@ -22,8 +59,43 @@ class RunAction : public G4UserRunAction
     {
       m_hDataFilename = hFilename;
     }
+    const G4String& GetDataFilename() const { return m_hDataFilename; }
+    /// Output file name without extension: out/1.root -> out/1
+    G4String GetBaseName() const;
+    void SetMasterSeed(G4long seed) { fMasterSeed = seed; }
+    void SetOutputMode(const G4String& mode);
+    OutputMode GetOutputMode() const { return fOutputMode; }
+    LightMap* GetLightMap() const { return fLightMap; }
+    StepProfile* GetStepProfile() const { return fStepProfile; }
+    PMTDigitizer* GetDigitizer() const { return fDigitizer; }
+    Trigger* GetTrigger() const { return fTrigger; }
+    ResponseMatrix* GetResponseMatrix() const { return fResponseMatrix; }
+    WriterMode GetWriterMode() const { return fWriterMode; }
+    OutputFormat GetOutputFormat() const { return fOutputFormat; }
+    OutputBuffer* GetOutputBuffer() const { return fOutputBuffer; }
+    /// Records go through the AsyncWriter (and not the ntuples)
+    G4bool UsesAsyncWriter() const
+    {
+      return ( fWriterMode == kAsyncWriter || fOutputFormat == kColumnarFormat )
+             && fOutputMode != kHistOutput;
+    }
+
   private:
+    void WriteMetadata(const G4Run* run) const;
+    void SetWriterMode(const G4String& mode);
+    void SetOutputFormat(const G4String& format);
+
     G4String m_hDataFilename;
+    OutputMode fOutputMode;
+    G4GenericMessenger* fMessenger;
+    LightMap* fLightMap;
+    StepProfile* fStepProfile;
+    PMTDigitizer* fDigitizer;
+    Trigger* fTrigger;
+    ResponseMatrix* fResponseMatrix;
+    WriterMode fWriterMode;
+    OutputFormat fOutputFormat;
+    OutputBuffer* fOutputBuffer;
+    G4long fMasterSeed;
 };
 #endif
-
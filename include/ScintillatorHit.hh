@@ -0,0 +1,69 @@
+/// \file ScintillatorHit.hh
+/// \brief Definition of the ScintillatorHit class
+
+#ifndef ScintillatorHit_h
+#define ScintillatorHit_h 1
+
+#include "G4VHit.hh"
+#include "G4THitsCollection.hh"
+#include "G4Allocator.hh"
+#include "G4ThreeVector.hh"
+#include "globals.hh"
+
+/// Scintillator hit class
+///
+/// One hit per energy-depositing step of a non-optical particle in the
+/// scintillator: the deposit, the step mid-point and the step start time.
+
+class ScintillatorHit : public G4VHit
+{
+  public:
+    ScintillatorHit();
+    virtual ~ScintillatorHit();
+
+    inline void* operator new(size_t);
+    inline void  operator delete(void*);
+
+    // set methods
+    void SetEdep(G4double de) { fEdep = de; }
+    void SetTime(G4double t)  { fTime = t; }
+    void SetPos(const G4ThreeVector& pos)
+      { fPos[0] = pos.x(); fPos[1] = pos.y(); fPos[2] = pos.z(); }
+
+    // get methods
+    G4double GetEdep() const { return fEdep; }
+    G4double GetTime() const { return fTime; }
+    G4ThreeVector GetPos() const
+      { return G4ThreeVector(fPos[0], fPos[1], fPos[2]); }
+
+  private:
+    G4float fEdep;
+    G4float fTime;
+    G4float fPos[3];
+};
+
+//....oooOO0OOooo........oooOO0OOooo........oooOO0OOooo........oooOO0OOooo......
+
+typedef G4THitsCollection<ScintillatorHit> ScintillatorHitsCollection;
+
+extern G4ThreadLocal G4Allocator<ScintillatorHit>* ScintillatorHitAllocator;
+
+//....oooOO0OOooo........oooOO0OOooo........oooOO0OOooo........oooOO0OOooo......
+
+inline void* ScintillatorHit::operator new(size_t)
+{
+  if ( ! ScintillatorHitAllocator )
+    ScintillatorHitAllocator = new G4Allocator<ScintillatorHit>;
+  return (void *) ScintillatorHitAllocator->MallocSingle();
+}
+
+//....oooOO0OOooo........oooOO0OOooo........oooOO0OOooo........oooOO0OOooo......
+
+inline void ScintillatorHit::operator delete(void* hit)
+{
+  ScintillatorHitAllocator->FreeSingle((ScintillatorHit*) hit);
+}
+
+//....oooOO0OOooo........oooOO0OOooo........oooOO0OOooo........oooOO0OOooo......
+
+#endif
@@ -0,0 +1,37 @@
+/// \file ScintillatorSD.hh
+/// \brief Definition of the ScintillatorSD class
+
+#ifndef ScintillatorSD_h
+#define ScintillatorSD_h 1
+
+#include "G4VSensitiveDetector.hh"
+#include "ScintillatorHit.hh"
+
+class G4Step;
+class G4HCofThisEvent;
+class G4ParticleDefinition;
+
+/// Sensitive detector of the scintillator volume.
+///
+/// Records the energy deposits of charged particles (and local gamma
+/// deposits below cut) in the "ScintillatorHitsCollection"; optical photons
+/// are ignored.
+
+class ScintillatorSD : public G4VSensitiveDetector
+{
+  public:
+    ScintillatorSD(const G4String& name, const G4String& hitsCollectionName);
+    virtual ~ScintillatorSD();
+
+    // methods from base class
+    virtual void   Initialize(G4HCofThisEvent* hitCollection);
+    virtual G4bool ProcessHits(G4Step* step, G4TouchableHistory* history);
+
+  private:
+    ScintillatorHitsCollection* fHitsCollection;
+    const G4ParticleDefinition* fOpticalPhoton;
+};
+
+//....oooOO0OOooo........oooOO0OOooo........oooOO0OOooo........oooOO0OOooo......
+
+#endif
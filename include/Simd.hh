@@ -0,0 +1,17 @@
+/// \file Simd.hh
+/// \brief Vectorization hint for the hot loops
+
+#ifndef Simd_h
+#define Simd_h 1
+
+/// TOYMC_SIMD in front of a loop asks the compiler to vectorize it
+/// (#pragma omp simd). CMake enables it with -fopenmp-simd, which needs no
+/// OpenMP runtime; other builds get a plain loop.
+
+#ifdef TOYMC_OPENMP_SIMD
+#define TOYMC_SIMD _Pragma("omp simd")
+#else
+#define TOYMC_SIMD
+#endif
+
+#endif
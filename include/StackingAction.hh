@@ -0,0 +1,61 @@
+/// \file StackingAction.hh
+/// \brief Definition of the StackingAction class
+
+#ifndef StackingAction_h
+#define StackingAction_h 1
+
+#include "G4UserStackingAction.hh"
+#include "globals.hh"
+
+class EventAction;
+class G4GenericMessenger;
+class G4ParticleDefinition;
+class G4VPhysicalVolume;
+
+/// Stacking action class
+///
+/// Charged particles and gammas are tracked first, optical photons wait in
+/// the waiting stack. Once the urgent stack is empty the deposit of the
+/// event in the scintillator is known: below /toy/stack/threshold the
+/// photons are dropped, or with /toy/stack/abortBelowThreshold the whole
+/// event is aborted (and not written). /toy/stack/verbose 1 prints each
+/// such event with the number of photons dropped.
+/// Optical photons created outside the Scintillator and the Detector are
+/// killed when the world material has no RINDEX, since they cannot leave
+/// their volume.
+/// With /toy/optics/prescale the PDE is applied to the scintillation yield,
+/// so the Cerenkov photons are killed here with probability 1 - PDE.
+
+class StackingAction : public G4UserStackingAction
+{
+  public:
+    StackingAction(EventAction* eventAction);
+    virtual ~StackingAction();
+
+    // methods from base class
+    virtual G4ClassificationOfNewTrack ClassifyNewTrack(const G4Track* track);
+    virtual void NewStage();
+    virtual void PrepareNewEvent();
+
+  private:
+    G4double ScintillatorDeposit();
+
+    EventAction* fEventAction;
+    const G4ParticleDefinition* fOpticalPhoton;
+    const G4VPhysicalVolume* fScintillator;
+    const G4VPhysicalVolume* fDetector;
+    G4bool   fWorldIsOpaque;
+    G4double fCerenkovPDE;
+    G4int    fScintillatorHCID;
+
+    G4bool   fDeferPhotons;
+    G4bool   fKillFutilePhotons;
+    G4double fThreshold;
+    G4bool   fAbortBelowThreshold;
+    G4int    fVerbose;
+    G4GenericMessenger* fMessenger;
+};
+
+//....oooOO0OOooo........oooOO0OOooo........oooOO0OOooo........oooOO0OOooo......
+
+#endif
@@ -0,0 +1,78 @@
+/// \file StepProfile.hh
+/// \brief Definition of the StepProfile class
+
+#ifndef StepProfile_h
+#define StepProfile_h 1
+
+#include "G4VAccumulable.hh"
+#include "globals.hh"
+
+#include <chrono>
+#include <map>
+
+class G4GenericMessenger;
+class G4Step;
+class G4Track;
+class G4VPhysicalVolume;
+
+/// Where the tracking time goes.
+///
+/// With /toy/profile/enable true, every thread counts the steps, tracks and
+/// wall time spent per volume, per particle type and per creator process of
+/// the track. The wall time of a step is the time since the previous step
+/// (or the start of the track), so it includes the user actions and the
+/// sensitive detectors. The counters are merged at the end of run and the
+/// master prints them as a table.
+///
+/// Disabled, the hooks cost one test of a bool per step and track.
+
+class StepProfile : public G4VAccumulable
+{
+  public:
+    StepProfile();
+    virtual ~StepProfile();
+
+    // methods from base class
+    virtual void Merge(const G4VAccumulable& other);
+    virtual void Reset();
+
+    G4bool IsEnabled() const { return fEnabled; }
+
+    // called by TrackingAction and SteppingAction when enabled
+    void StartTrack(const G4Track* track);
+    void CountStep(const G4Step* step);
+
+    void Print() const;
+
+  private:
+    typedef std::chrono::steady_clock Clock;
+
+    struct Entry
+    {
+      G4long   steps = 0;
+      G4long   tracks = 0;
+      G4double time = 0.;   // s
+    };
+    typedef std::map<G4String, Entry> Table;
+
+    static void MergeTable(Table& table, const Table& other);
+    void PrintTable(const G4String& title, const Table& table) const;
+
+    G4bool fEnabled;
+    G4GenericMessenger* fMessenger;
+
+    Table fVolumes;
+    Table fParticles;
+    Table fProcesses;
+
+    // current track and volume, to keep map lookups out of most steps
+    Entry* fParticle;
+    Entry* fProcess;
+    const G4VPhysicalVolume* fLastVolume;
+    Entry* fVolume;
+    Clock::time_point fLastTime;
+};
+
+//....oooOO0OOooo........oooOO0OOooo........oooOO0OOooo........oooOO0OOooo......
+
+#endif
@@ -8,16 +8,19 @@
 #include "globals.hh"
 
 class EventAction;
+class StepProfile;
 
 class G4LogicalVolume;
 
 /// Stepping action class
-/// 
+///
+/// Counts the steps of the event and feeds the StepProfile when profiling
+/// is enabled.
 
 class SteppingAction : public G4UserSteppingAction
 {
   public:
-    SteppingAction(EventAction* eventAction);
+    SteppingAction(EventAction* eventAction, StepProfile* profile);
     virtual ~SteppingAction();
 
     // method from the base class
@@ -25,6 +28,7 @@ class SteppingAction : public G4UserSteppingAction
 
   private:
     EventAction*  fEventAction;
+    StepProfile*  fProfile;
     G4LogicalVolume* fScoringVolume;
 };
 
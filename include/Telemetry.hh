@@ -0,0 +1,85 @@
+/// \file Telemetry.hh
+/// \brief Definition of the Telemetry class
+
+#ifndef Telemetry_h
+#define Telemetry_h 1
+
+#include "globals.hh"
+
+#include <atomic>
+#include <chrono>
+#include <memory>
+#include <mutex>
+
+class G4GenericMessenger;
+
+/// Run progress telemetry.
+///
+/// Each thread counts its completed events, steps and tracked optical
+/// photons in its own slot. At the end of an event the thread checks the
+/// clock and, once per /toy/telemetry/interval, one thread writes a
+/// snapshot to /toy/telemetry/file as a small JSON document: events done,
+/// events/s, steps/s, optical photons/s and the estimated time remaining,
+/// per thread and in total, and the peak resident set size of the process.
+/// The file is replaced atomically, so it can be polled at any time.
+///
+/// The time from the creation of the singleton (at the start of main) to the
+/// start of the first run is reported as the initialization time.
+///
+/// The singleton is created by the master; its commands are not broadcast.
+
+class Telemetry
+{
+  public:
+    static Telemetry* Instance();
+    ~Telemetry();
+
+    /// Master, before the workers start
+    void BeginRun(G4int runID, G4long eventsToProcess, G4int nThreads);
+    /// Master, after the workers are done
+    void EndRun();
+
+    /// Worker threads, at the end of each event
+    void EventDone(G4long nSteps, G4long nPhotons);
+
+    /// Peak resident set size of the process in kB
+    static G4long PeakRSS();
+    /// Seconds from start-up to the first run (negative before it)
+    G4double GetInitTime() const { return fInitTime; }
+
+  private:
+    Telemetry();
+    void Write();
+    G4int Slot() const;
+
+    typedef std::chrono::steady_clock Clock;
+
+    // Two cache lines per slot, so that the counters of two slots never
+    // share a line whatever the alignment of the array (over-aligned new
+    // needs C++17)
+    struct Counters
+    {
+      std::atomic<G4long> events{0};
+      std::atomic<G4long> steps{0};
+      std::atomic<G4long> photons{0};
+      char padding[128 - 3*sizeof(std::atomic<G4long>)];
+    };
+
+    G4String fFileName;
+    G4double fInterval;
+    G4GenericMessenger* fMessenger;
+
+    Clock::time_point fProcessStart;
+    G4double fInitTime;
+    G4int fRunID;
+    G4long fEventsToProcess;
+    G4int fNSlots;
+    std::unique_ptr<Counters[]> fCounters;
+    Clock::time_point fRunStart;
+    std::atomic<Clock::rep> fNextWrite;
+    std::mutex fWriteMutex;
+};
+
+//....oooOO0OOooo........oooOO0OOooo........oooOO0OOooo........oooOO0OOooo......
+
+#endif
@@ -0,0 +1,34 @@
+/// \file TrackingAction.hh
+/// \brief Definition of the TrackingAction class
+
+#ifndef TrackingAction_h
+#define TrackingAction_h 1
+
+#include "G4UserTrackingAction.hh"
+#include "globals.hh"
+
+class StepProfile;
+
+/// Tracking action class
+///
+/// Counts the tracks for the StepProfile when profiling is enabled, and
+/// has the photons collected by the OpticalBoxModel traced once the last
+/// track of the event is done, so that those leaving the box are tracked.
+
+class TrackingAction : public G4UserTrackingAction
+{
+  public:
+    TrackingAction(StepProfile* profile);
+    virtual ~TrackingAction();
+
+    // methods from the base class
+    virtual void PreUserTrackingAction(const G4Track* track);
+    virtual void PostUserTrackingAction(const G4Track* track);
+
+  private:
+    StepProfile* fProfile;
+};
+
+//....oooOO0OOooo........oooOO0OOooo........oooOO0OOooo........oooOO0OOooo......
+
+#endif
@@ -0,0 +1,64 @@
+/// \file Trigger.hh
+/// \brief Definition of the Trigger class
+
+#ifndef Trigger_h
+#define Trigger_h 1
+
+#include "G4VAccumulable.hh"
+#include "globals.hh"
+
+#include <vector>
+
+class G4GenericMessenger;
+
+/// Event trigger of the output.
+///
+/// An event is written (event row and, in step mode, its step rows) only
+/// if it passes every enabled condition:
+///  - /toy/trigger/minPhotons n: at least n detected photons within
+///    /toy/trigger/window (sliding, from any photon of the event)
+///  - /toy/trigger/minEdep e:    a deposit of at least e in the scintillator
+/// Both are off (0) by default. The histograms are filled for all events,
+/// so the trigger efficiency can be read from them. Accepted and rejected
+/// events are counted per thread, merged at the end of run, printed in the
+/// run summary and written to the .meta file.
+
+class Trigger : public G4VAccumulable
+{
+  public:
+    Trigger();
+    virtual ~Trigger();
+
+    // methods from base class
+    virtual void Merge(const G4VAccumulable& other);
+    virtual void Reset();
+
+    G4bool IsEnabled() const { return fMinPhotons > 0 || fMinEdep > 0.; }
+    /// Decide on an event from its detected photon arrival times and its
+    /// scintillator deposit, and count it
+    G4bool Accept(const std::vector<G4double>& photonTimes, G4double edep);
+
+    G4int GetMinPhotons() const { return fMinPhotons; }
+    G4double GetWindow() const { return fWindow; }
+    G4double GetMinEdep() const { return fMinEdep; }
+    G4long GetAccepted() const { return fAccepted; }
+    G4long GetRejected() const { return fRejected; }
+
+    void Print() const;
+
+  private:
+    G4int MaxPhotonsInWindow(const std::vector<G4double>& photonTimes);
+
+    G4int    fMinPhotons;
+    G4double fWindow;
+    G4double fMinEdep;
+    G4GenericMessenger* fMessenger;
+
+    G4long fAccepted;
+    G4long fRejected;
+    std::vector<G4double> fSortedTimes;   // working buffer
+};
+
+//....oooOO0OOooo........oooOO0OOooo........oooOO0OOooo........oooOO0OOooo......
+
+#endif
@@ -0,0 +1,73 @@
+# coding=utf-8
+# Read the columnar output of toyMC (/toy/output/format columnar) without
+# ROOT; the columns are memory-mapped, nothing is read until it is used:
+#   python3 read_columnar.py out/1.cols [eventID]
+# or as a module:
+#   cols = Columnar('out/1.cols')
+#   cols.event['edep']          # whole column
+#   cols.event_by_id(42)        # dict of the event's values
+#   cols.steps_of(42)           # dict of its step columns
+import json
+import os
+import sys
+import numpy as np
+
+class Columnar:
+    def __init__(self, directory):
+        self.directory = directory
+        with open(os.path.join(directory, 'schema.json')) as f:
+            self.schema = json.load(f)
+        self.event = self._table('event')
+        self.step = self._table('step')
+        index = self.schema['index']
+        self.step_begin = self._map('index/step_begin.bin', index['step_begin'])
+        # (eventID, row) pairs sorted by eventID
+        event_row = np.dtype([(name, dtype) for name, dtype in index['event_row']])
+        self.event_row = self._map('index/event_row.bin', event_row)
+
+    def _map(self, name, dtype):
+        path = os.path.join(self.directory, name)
+        if os.path.getsize(path) == 0:
+            return np.zeros(0, dtype)
+        return np.memmap(path, dtype=dtype, mode='r')
+
+    def _table(self, table):
+        columns = self.schema['tables'][table]['columns']
+        return {name: self._map(f'{table}/{name}.bin', dtype)
+                for name, dtype in columns}
+
+    def row_of(self, event_id):
+        """Event row of an eventID, or -1 if it was not written"""
+        ids = self.event_row['eventID']
+        i = int(np.searchsorted(ids, event_id))
+        if i == len(ids) or ids[i] != event_id:
+            return -1
+        return int(self.event_row['row'][i])
+
+    def event_by_id(self, event_id):
+        row = self.row_of(event_id)
+        if row < 0:
+            raise KeyError(event_id)
+        return {name: column[row] for name, column in self.event.items()}
+
+    def step_rows(self, row):
+        """Step rows of event row row, as a slice"""
+        return slice(int(self.step_begin[row]), int(self.step_begin[row + 1]))
+
+    def steps_of(self, event_id):
+        row = self.row_of(event_id)
+        if row < 0:
+            raise KeyError(event_id)
+        rows = self.step_rows(row)
+        return {name: column[rows] for name, column in self.step.items()}
+
+if __name__ == '__main__':
+    cols = Columnar(sys.argv[1])
+    tables = cols.schema['tables']
+    print(f'{tables["event"]["rows"]} events, {tables["step"]["rows"]} steps')
+    if len(sys.argv) > 2:
+        event_id = int(sys.argv[2])
+        for name, value in cols.event_by_id(event_id).items():
+            print(f'{name:12s} {value}')
+        steps = cols.steps_of(event_id)
+        print(f'{len(steps["dE"])} steps, dE sum {steps["dE"].sum():.4g}')
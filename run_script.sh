@@ -1,11 +1,20 @@
 #!/bin/bash
 
+# One multithreaded toyMC process uses every core of the node and writes a
+# single merged output file. Set NJOBS > 1 only to split a job across
+# independent processes; the cores are then shared between them unless
+# NTHREADS sets the number of workers of each process.
+# A job killed during a checkpointed run (/toy/checkpoint/beamOn in MACRO)
+# continues from its last checkpoint when the script is run again.
 MC_HOME='.'
-for i in $(seq 1 50)
+NJOBS=${NJOBS:-1}
+NTHREADS=${NTHREADS:-$(( $(nproc) / NJOBS > 0 ? $(nproc) / NJOBS : 1 ))}
+mkdir -p out
+for i in $(seq 1 $NJOBS)
   do
     export Filename='out/'$i
     export Logfile='out/log'$i'.txt'
-    $MC_HOME/build/toyMC run.mac $Filename i >$Logfile &
+    $MC_HOME/build/toyMC ${MACRO:-run.mac} $Filename -t $NTHREADS --resume >>$Logfile &
     echo "$i" 
   done
-
+wait
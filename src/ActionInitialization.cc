@@ -6,6 +6,8 @@
 #include "RunAction.hh"
 #include "EventAction.hh"
 #include "SteppingAction.hh"
+#include "StackingAction.hh"
+#include "TrackingAction.hh"
 
 //....oooOO0OOooo........oooOO0OOooo........oooOO0OOooo........oooOO0OOooo......
 
@@ -24,6 +26,7 @@ void ActionInitialization::BuildForMaster() const
 {
   RunAction* runAction = new RunAction;
   runAction->SetDataFilenamemy(m_hDataFilename);
+  runAction->SetMasterSeed(fMasterSeed);
   SetUserAction(runAction);
 }
 
@@ -31,16 +34,22 @@ void ActionInitialization::BuildForMaster() const
 
 void ActionInitialization::Build() const
 {
-  SetUserAction(new PrimaryGeneratorAction);
-
   RunAction* runAction = new RunAction;
   runAction->SetDataFilenamemy(m_hDataFilename);
+  // In a sequential build this run action also writes the metadata
+  runAction->SetMasterSeed(fMasterSeed);
   SetUserAction(runAction);
+
+  auto generatorAction = new PrimaryGeneratorAction(fMasterSeed, fReplayEvents);
+  generatorAction->SetResponseMatrix(runAction->GetResponseMatrix());
+  SetUserAction(generatorAction);
   
   EventAction* eventAction = new EventAction(runAction);
   SetUserAction(eventAction);
   
-  SetUserAction(new SteppingAction(eventAction));
+  SetUserAction(new SteppingAction(eventAction, runAction->GetStepProfile()));
+  SetUserAction(new TrackingAction(runAction->GetStepProfile()));
+  SetUserAction(new StackingAction(eventAction));
 }  
 
 //....oooOO0OOooo........oooOO0OOooo........oooOO0OOooo........oooOO0OOooo......
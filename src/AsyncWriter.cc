@@ -0,0 +1,207 @@
+/// \file AsyncWriter.cc
+/// \brief Implementation of the AsyncWriter and OutputBuffer classes
+
+#include "AsyncWriter.hh"
+#include "ColumnarSink.hh"
+#ifdef TOYMC_WITH_ROOT
+#include "RootSink.hh"
+#endif
+
+#include "G4GenericMessenger.hh"
+#include "G4Exception.hh"
+
+#include <algorithm>
+
+//....oooOO0OOooo........oooOO0OOooo........oooOO0OOooo........oooOO0OOooo......
+
+AsyncWriter* AsyncWriter::Instance()
+{
+  // Never deleted: its commands must outlive the UI manager
+  static AsyncWriter* instance = new AsyncWriter();
+  return instance;
+}
+
+//....oooOO0OOooo........oooOO0OOooo........oooOO0OOooo........oooOO0OOooo......
+
+AsyncWriter::AsyncWriter()
+ : fMessenger(0),
+   fMemoryCap(256.),
+   fCompression(505),
+   fBasketSize(64000),
+   fSink(0),
+   fBatchBytes(0),
+   fStop(false)
+{
+  fMessenger = new G4GenericMessenger(this, "/toy/output/async/",
+                                      "Asynchronous output writer");
+  auto& capCmd = fMessenger->DeclareProperty("memoryCap", fMemoryCap,
+    "Upper bound of the records buffered by all threads, in MB");
+  capCmd.SetRange("memoryCap>0.");
+  capCmd.SetToBeBroadcasted(false);
+  auto& compressionCmd = fMessenger->DeclareProperty("compression",
+    fCompression, "ROOT compression: 100*algorithm + level, e.g. 505 (ZSTD 5)");
+  compressionCmd.SetRange("compression>=0");
+  compressionCmd.SetToBeBroadcasted(false);
+  auto& basketCmd = fMessenger->DeclareProperty("basketSize", fBasketSize,
+    "ROOT basket size of every branch in bytes");
+  basketCmd.SetRange("basketSize>=1000");
+  basketCmd.SetToBeBroadcasted(false);
+}
+
+//....oooOO0OOooo........oooOO0OOooo........oooOO0OOooo........oooOO0OOooo......
+
+AsyncWriter::~AsyncWriter()
+{
+  Close();
+  delete fMessenger;
+}
+
+//....oooOO0OOooo........oooOO0OOooo........oooOO0OOooo........oooOO0OOooo......
+
+G4bool AsyncWriter::Open(const G4String& fileName, G4int nThreads,
+                         Format format)
+{
+  Close();
+  if ( format == kColumnar ) fSink = new ColumnarSink;
+#ifdef TOYMC_WITH_ROOT
+  else fSink = new RootSink(fCompression, fBasketSize);
+#endif
+  if ( ! fSink ) {
+    G4Exception("AsyncWriter::Open()", "toyMC_out001", JustWarning,
+      "toyMC was built without ROOT, the async writer has no output format;"
+      " no records are written.");
+    return false;
+  }
+  if ( ! fSink->Open(fileName) ) {
+    G4ExceptionDescription msg;
+    msg << "Cannot create " << fileName;
+    G4Exception("AsyncWriter::Open()", "toyMC_out002", JustWarning, msg);
+    delete fSink;
+    fSink = 0;
+    return false;
+  }
+  fBatchBytes = std::max<std::size_t>(
+    fMemoryCap*1.e6/( 2*std::max(nThreads, 1) ), 64*sizeof(StepRecord));
+  fStop = false;
+  fThread = std::thread(&AsyncWriter::Loop, this);
+  return true;
+}
+
+//....oooOO0OOooo........oooOO0OOooo........oooOO0OOooo........oooOO0OOooo......
+
+void AsyncWriter::Close()
+{
+  if ( ! fSink ) return;
+  {
+    std::lock_guard<std::mutex> lock(fMutex);
+    fStop = true;
+  }
+  fQueued.notify_one();
+  fThread.join();
+  fSink->Close();
+  delete fSink;
+  fSink = 0;
+}
+
+//....oooOO0OOooo........oooOO0OOooo........oooOO0OOooo........oooOO0OOooo......
+
+void AsyncWriter::Submit(OutputBatch* batch)
+{
+  if ( ! fSink ) {
+    batch->events.clear();
+    batch->steps.clear();
+    return;
+  }
+  {
+    std::lock_guard<std::mutex> lock(fMutex);
+    batch->pending = true;
+    fQueue.push_back(batch);
+  }
+  fQueued.notify_one();
+}
+
+//....oooOO0OOooo........oooOO0OOooo........oooOO0OOooo........oooOO0OOooo......
+
+void AsyncWriter::WaitFor(OutputBatch* batch)
+{
+  std::unique_lock<std::mutex> lock(fMutex);
+  fWritten.wait(lock, [batch] { return ! batch->pending; });
+}
+
+//....oooOO0OOooo........oooOO0OOooo........oooOO0OOooo........oooOO0OOooo......
+
+void AsyncWriter::Loop()
+{
+  std::unique_lock<std::mutex> lock(fMutex);
+  while ( true ) {
+    fQueued.wait(lock, [this] { return fStop || ! fQueue.empty(); });
+    if ( fQueue.empty() ) break;   // stopped and drained
+    OutputBatch* batch = fQueue.front();
+    fQueue.pop_front();
+
+    // The batch belongs to the writer until pending is reset
+    lock.unlock();
+    fSink->Write(*batch);
+    batch->events.clear();
+    batch->steps.clear();
+    lock.lock();
+
+    batch->pending = false;
+    fWritten.notify_all();
+  }
+}
+
+//....oooOO0OOooo........oooOO0OOooo........oooOO0OOooo........oooOO0OOooo......
+
+OutputBuffer::OutputBuffer()
+ : fCurrent(0)
+{}
+
+//....oooOO0OOooo........oooOO0OOooo........oooOO0OOooo........oooOO0OOooo......
+
+OutputBuffer::~OutputBuffer()
+{
+  Flush();
+}
+
+//....oooOO0OOooo........oooOO0OOooo........oooOO0OOooo........oooOO0OOooo......
+
+void OutputBuffer::Add(const EventRecord& record)
+{
+  fBatches[fCurrent].events.push_back(record);
+}
+
+//....oooOO0OOooo........oooOO0OOooo........oooOO0OOooo........oooOO0OOooo......
+
+void OutputBuffer::Add(const StepRecord& record)
+{
+  fBatches[fCurrent].steps.push_back(record);
+}
+
+//....oooOO0OOooo........oooOO0OOooo........oooOO0OOooo........oooOO0OOooo......
+
+void OutputBuffer::EndEvent()
+{
+  AsyncWriter* writer = AsyncWriter::Instance();
+  if ( fBatches[fCurrent].Bytes() < writer->GetBatchBytes() ) return;
+  // The other batch must be written before it is filled again
+  OutputBatch* full = &fBatches[fCurrent];
+  fCurrent = 1 - fCurrent;
+  writer->WaitFor(&fBatches[fCurrent]);
+  writer->Submit(full);
+}
+
+//....oooOO0OOooo........oooOO0OOooo........oooOO0OOooo........oooOO0OOooo......
+
+void OutputBuffer::Flush()
+{
+  AsyncWriter* writer = AsyncWriter::Instance();
+  OutputBatch& current = fBatches[fCurrent];
+  if ( ! current.events.empty() || ! current.steps.empty() ) {
+    writer->Submit(&current);
+  }
+  writer->WaitFor(&fBatches[0]);
+  writer->WaitFor(&fBatches[1]);
+}
+
+//....oooOO0OOooo........oooOO0OOooo........oooOO0OOooo........oooOO0OOooo......
@@ -0,0 +1,175 @@
+/// \file Checkpoint.cc
+/// \brief Implementation of the Checkpoint class
+
+#include "Checkpoint.hh"
+#include "RunAction.hh"
+
+#include "G4GenericMessenger.hh"
+#include "G4RunManager.hh"
+#include "G4Run.hh"
+#include "G4UImanager.hh"
+
+#include <algorithm>
+#include <cstdio>
+#include <fstream>
+#include <sstream>
+
+//....oooOO0OOooo........oooOO0OOooo........oooOO0OOooo........oooOO0OOooo......
+
+Checkpoint* Checkpoint::Instance()
+{
+  // Never deleted: its commands must outlive the UI manager
+  static Checkpoint* instance = new Checkpoint();
+  return instance;
+}
+
+//....oooOO0OOooo........oooOO0OOooo........oooOO0OOooo........oooOO0OOooo......
+
+Checkpoint::Checkpoint()
+ : fInterval(0),
+   fMasterSeed(0),
+   fFirstEvent(0),
+   fSeedRun(-1),
+   fMessenger(0),
+   fLoaded(false),
+   fSeed(0),
+   fRun(0),
+   fEvents(0),
+   fEventsDone(0)
+{
+  fMessenger = new G4GenericMessenger(this, "/toy/checkpoint/",
+                                      "Checkpointed runs");
+  auto& intervalCmd = fMessenger->DeclareProperty("interval", fInterval,
+    "Events per chunk of /toy/checkpoint/beamOn (0: a single chunk)");
+  intervalCmd.SetParameterName("events", false);
+  intervalCmd.SetRange("events>=0");
+  intervalCmd.SetToBeBroadcasted(false);
+  auto& beamOnCmd = fMessenger->DeclareMethod("beamOn", &Checkpoint::BeamOn,
+    "Process events in chunks, writing a segment and a checkpoint after each");
+  beamOnCmd.SetParameterName("events", false);
+  beamOnCmd.SetRange("events>0");
+  beamOnCmd.SetToBeBroadcasted(false);
+}
+
+//....oooOO0OOooo........oooOO0OOooo........oooOO0OOooo........oooOO0OOooo......
+
+Checkpoint::~Checkpoint()
+{
+  delete fMessenger;
+}
+
+//....oooOO0OOooo........oooOO0OOooo........oooOO0OOooo........oooOO0OOooo......
+
+G4bool Checkpoint::Load(const G4String& fileName)
+{
+  std::ifstream in(fileName);
+  if ( ! in ) return false;
+
+  fSegments.clear();
+  G4int found = 0;
+  G4String line;
+  while ( std::getline(in, line) ) {
+    std::istringstream is(line);
+    G4String key;
+    is >> key;
+    if ( key == "seed" && is >> fSeed ) ++found;
+    else if ( key == "run" && is >> fRun ) ++found;
+    else if ( key == "events" && is >> fEvents ) ++found;
+    else if ( key == "eventsDone" && is >> fEventsDone ) ++found;
+    else if ( key == "segment" ) {
+      G4String segment;
+      if ( is >> segment ) fSegments.push_back(segment);
+    }
+  }
+  if ( found != 4 ) {
+    G4ExceptionDescription ed;
+    ed << "Incomplete checkpoint " << fileName << ", starting from scratch";
+    G4Exception("Checkpoint::Load()", "toyMC_ckpt001", JustWarning, ed);
+    return false;
+  }
+  fLoaded = true;
+  return true;
+}
+
+//....oooOO0OOooo........oooOO0OOooo........oooOO0OOooo........oooOO0OOooo......
+
+void Checkpoint::Save(const G4String& fileName) const
+{
+  // Written aside and renamed, so a kill leaves the previous checkpoint
+  G4String tmpName = fileName + ".tmp";
+  {
+    std::ofstream out(tmpName);
+    out << "seed " << fSeed << "\n"
+        << "run " << fRun << "\n"
+        << "events " << fEvents << "\n"
+        << "eventsDone " << fEventsDone << "\n";
+    for ( const auto& segment : fSegments ) out << "segment " << segment << "\n";
+  }
+  std::rename(tmpName.c_str(), fileName.c_str());
+}
+
+//....oooOO0OOooo........oooOO0OOooo........oooOO0OOooo........oooOO0OOooo......
+
+void Checkpoint::BeamOn(G4int nEvents)
+{
+  auto runManager = G4RunManager::GetRunManager();
+  auto runAction
+    = static_cast<const RunAction*>(runManager->GetUserRunAction());
+  if ( ! runAction ) {
+    G4Exception("Checkpoint::BeamOn()", "toyMC_ckpt002", JustWarning,
+                "No run action, /run/initialize first");
+    return;
+  }
+  const G4String output = runAction->GetDataFilename();
+  const G4String base = runAction->GetBaseName();
+  const G4String extension = output.substr(base.size());
+  const G4String fileName = base + ".ckpt";
+
+  if ( fLoaded ) {
+    if ( fSeed != fMasterSeed || fEvents != nEvents ) {
+      G4ExceptionDescription ed;
+      ed << fileName << " is the checkpoint of " << fEvents
+         << " events with seed " << fSeed << ", not of " << nEvents
+         << " events with seed " << fMasterSeed;
+      G4Exception("Checkpoint::BeamOn()", "toyMC_ckpt003", FatalException, ed);
+      return;
+    }
+    G4cout << "Resuming from " << fileName << ": " << fEventsDone << " of "
+           << fEvents << " events done" << G4endl;
+  }
+  else {
+    fSeed = fMasterSeed;
+    // The first chunk is the next run
+    const G4Run* lastRun = runManager->GetCurrentRun();
+    fRun = lastRun ? lastRun->GetRunID() + 1 : 0;
+    fEvents = nEvents;
+    fEventsDone = 0;
+    fSegments.clear();
+  }
+
+  G4UImanager* UImanager = G4UImanager::GetUIpointer();
+  const G4int interval = ( fInterval > 0 ) ? fInterval : nEvents;
+  fSeedRun = fRun;
+  while ( fEventsDone < fEvents ) {
+    G4int nChunk = std::min(interval, fEvents - fEventsDone);
+    std::ostringstream segment;
+    segment << base << ".part" << fSegments.size() << extension;
+    UImanager->ApplyCommand("/toy/output/file " + segment.str());
+    fFirstEvent = fEventsDone;
+    runManager->BeamOn(nChunk);
+
+    // An aborted chunk is redone on resume
+    const G4Run* run = runManager->GetCurrentRun();
+    if ( ! run || run->GetNumberOfEvent() < nChunk ) break;
+    fEventsDone += nChunk;
+    fSegments.push_back(segment.str());
+    Save(fileName);
+  }
+
+  fFirstEvent = 0;
+  fSeedRun = -1;
+  fLoaded = false;
+  UImanager->ApplyCommand("/toy/output/file " + output);
+}
+
+//....oooOO0OOooo........oooOO0OOooo........oooOO0OOooo........oooOO0OOooo......
@@ -0,0 +1,216 @@
+/// \file ColumnarSink.cc
+/// \brief Implementation of the ColumnarSink class
+
+#include "ColumnarSink.hh"
+
+#include <sys/stat.h>
+#include <algorithm>
+#include <cstddef>
+#include <cstdint>
+#include <cstring>
+#include <utility>
+
+namespace {
+  const char* ByteOrder()
+  {
+    const std::uint16_t one = 1;
+    return ( *reinterpret_cast<const char*>(&one) == 1 ) ? "<" : ">";
+  }
+
+  ColumnarSink::Column MakeColumn(const char* name, const char* dtype,
+                                  std::size_t offset, std::size_t size)
+  {
+    ColumnarSink::Column column;
+    column.name = name;
+    column.dtype = dtype;
+    column.offset = offset;
+    column.size = size;
+    return column;
+  }
+}
+
+#define TOYMC_COLUMN(Record, name, member, dtype) \
+  MakeColumn(name, dtype, offsetof(Record, member), sizeof(Record::member))
+#define TOYMC_ARRAY_COLUMN(Record, name, member, k, dtype) \
+  MakeColumn(name, dtype, offsetof(Record, member) + k*sizeof(Record::member[0]), \
+             sizeof(Record::member[0]))
+
+//....oooOO0OOooo........oooOO0OOooo........oooOO0OOooo........oooOO0OOooo......
+
+ColumnarSink::ColumnarSink()
+ : fEventRows(0),
+   fStepRows(0)
+{
+  // Same names as the ntuple columns
+  fEventColumns.push_back(TOYMC_COLUMN(EventRecord, "eventID", eventID, "i4"));
+  fEventColumns.push_back(TOYMC_COLUMN(EventRecord, "nPhotons", nPhotons, "i4"));
+  fEventColumns.push_back(TOYMC_COLUMN(EventRecord, "firstTime", firstTime, "f4"));
+  fEventColumns.push_back(TOYMC_COLUMN(EventRecord, "meanTime", meanTime, "f4"));
+  fEventColumns.push_back(TOYMC_COLUMN(EventRecord, "edep", edep, "f4"));
+  fEventColumns.push_back(TOYMC_COLUMN(EventRecord, "primaryE", primaryEnergy, "f4"));
+  fEventColumns.push_back(TOYMC_COLUMN(EventRecord, "primaryPDG", primaryPDG, "i4"));
+  fEventColumns.push_back(TOYMC_COLUMN(EventRecord, "qTotal", qTotal, "f4"));
+  fEventColumns.push_back(TOYMC_COLUMN(EventRecord, "qTail", qTail, "f4"));
+  fEventColumns.push_back(TOYMC_COLUMN(EventRecord, "weight", weight, "f4"));
+
+  fStepColumns.push_back(TOYMC_COLUMN(StepRecord, "Energy", energy, "f4"));
+  fStepColumns.push_back(TOYMC_ARRAY_COLUMN(StepRecord, "prex", pre, 0, "f4"));
+  fStepColumns.push_back(TOYMC_ARRAY_COLUMN(StepRecord, "prey", pre, 1, "f4"));
+  fStepColumns.push_back(TOYMC_ARRAY_COLUMN(StepRecord, "prez", pre, 2, "f4"));
+  fStepColumns.push_back(TOYMC_ARRAY_COLUMN(StepRecord, "postx", post, 0, "f4"));
+  fStepColumns.push_back(TOYMC_ARRAY_COLUMN(StepRecord, "posty", post, 1, "f4"));
+  fStepColumns.push_back(TOYMC_ARRAY_COLUMN(StepRecord, "postz", post, 2, "f4"));
+  fStepColumns.push_back(TOYMC_COLUMN(StepRecord, "pdg", pdg, "i4"));
+  fStepColumns.push_back(TOYMC_COLUMN(StepRecord, "eventID", eventID, "i4"));
+  fStepColumns.push_back(TOYMC_COLUMN(StepRecord, "trackID", trackID, "i4"));
+  fStepColumns.push_back(TOYMC_COLUMN(StepRecord, "parentID", parentID, "i4"));
+  fStepColumns.push_back(TOYMC_COLUMN(StepRecord, "dE", edep, "f4"));
+  fStepColumns.push_back(TOYMC_COLUMN(StepRecord, "weight", weight, "f4"));
+}
+
+#undef TOYMC_COLUMN
+#undef TOYMC_ARRAY_COLUMN
+
+//....oooOO0OOooo........oooOO0OOooo........oooOO0OOooo........oooOO0OOooo......
+
+ColumnarSink::~ColumnarSink()
+{
+  Close();
+}
+
+//....oooOO0OOooo........oooOO0OOooo........oooOO0OOooo........oooOO0OOooo......
+
+G4bool ColumnarSink::Open(const G4String& fileName)
+{
+  // out/1.root -> out/1.cols
+  fDirectory = fileName;
+  std::size_t dot = fDirectory.rfind('.');
+  std::size_t slash = fDirectory.rfind('/');
+  if ( dot != std::string::npos
+       && ( slash == std::string::npos || dot > slash + 1 ) ) {
+    fDirectory = fDirectory.substr(0, dot);
+  }
+  fDirectory += ".cols";
+  for ( G4String dir : { fDirectory, fDirectory + "/event",
+                         fDirectory + "/step", fDirectory + "/index" } ) {
+    mkdir(dir.c_str(), 0755);
+  }
+
+  const std::ios::openmode mode = std::ios::binary | std::ios::trunc;
+  for ( auto& column : fEventColumns ) {
+    G4String path = fDirectory + "/event/" + column.name + ".bin";
+    column.file.reset(new std::ofstream(path, mode));
+    if ( ! *column.file ) return false;
+  }
+  for ( auto& column : fStepColumns ) {
+    G4String path = fDirectory + "/step/" + column.name + ".bin";
+    column.file.reset(new std::ofstream(path, mode));
+    if ( ! *column.file ) return false;
+  }
+  fStepBegin.reset(new std::ofstream(fDirectory + "/index/step_begin.bin", mode));
+  fEventRows = fStepRows = 0;
+  return static_cast<bool>(*fStepBegin);
+}
+
+//....oooOO0OOooo........oooOO0OOooo........oooOO0OOooo........oooOO0OOooo......
+
+template <class Record>
+void ColumnarSink::WriteColumns(std::vector<Column>& columns,
+                                const std::vector<Record>& records)
+{
+  // Transpose the records one column at a time
+  for ( auto& column : columns ) {
+    fScratch.resize(records.size()*column.size);
+    char* out = fScratch.data();
+    for ( const auto& record : records ) {
+      std::memcpy(out, reinterpret_cast<const char*>(&record) + column.offset,
+                  column.size);
+      out += column.size;
+    }
+    column.file->write(fScratch.data(), fScratch.size());
+  }
+}
+
+//....oooOO0OOooo........oooOO0OOooo........oooOO0OOooo........oooOO0OOooo......
+
+void ColumnarSink::Write(const OutputBatch& batch)
+{
+  // Index: the steps of each event follow those of the previous one
+  std::size_t step = 0;
+  for ( const auto& event : batch.events ) {
+    long long begin = fStepRows + step;
+    fStepBegin->write(reinterpret_cast<const char*>(&begin), sizeof(begin));
+    while ( step < batch.steps.size()
+            && batch.steps[step].eventID == event.eventID ) ++step;
+    ++fEventRows;
+  }
+  fStepRows += batch.steps.size();
+
+  WriteColumns(fEventColumns, batch.events);
+  WriteColumns(fStepColumns, batch.steps);
+}
+
+//....oooOO0OOooo........oooOO0OOooo........oooOO0OOooo........oooOO0OOooo......
+
+void ColumnarSink::Close()
+{
+  if ( ! fStepBegin ) return;
+  fStepBegin->write(reinterpret_cast<const char*>(&fStepRows), sizeof(fStepRows));
+  fStepBegin.reset();
+  for ( auto& column : fEventColumns ) column.file.reset();
+  for ( auto& column : fStepColumns ) column.file.reset();
+
+  WriteEventIndex();
+  WriteSchema();
+}
+
+//....oooOO0OOooo........oooOO0OOooo........oooOO0OOooo........oooOO0OOooo......
+
+void ColumnarSink::WriteEventIndex() const
+{
+  // (eventID, row) of every event row, from the eventID column, sorted by
+  // eventID
+  std::ifstream eventID(fDirectory + "/event/eventID.bin", std::ios::binary);
+  std::vector<std::pair<long long, long long> > index;
+  index.reserve(fEventRows);
+  std::int32_t id;
+  for ( long long row = 0; row < fEventRows; ++row ) {
+    if ( ! eventID.read(reinterpret_cast<char*>(&id), sizeof(id)) ) break;
+    index.push_back(std::make_pair(static_cast<long long>(id), row));
+  }
+  std::sort(index.begin(), index.end());
+
+  std::ofstream out(fDirectory + "/index/event_row.bin", std::ios::binary);
+  for ( const auto& entry : index ) {
+    out.write(reinterpret_cast<const char*>(&entry.first), sizeof(long long));
+    out.write(reinterpret_cast<const char*>(&entry.second), sizeof(long long));
+  }
+}
+
+//....oooOO0OOooo........oooOO0OOooo........oooOO0OOooo........oooOO0OOooo......
+
+void ColumnarSink::WriteSchema() const
+{
+  const char* order = ByteOrder();
+  std::ofstream out(fDirectory + "/schema.json");
+  out << "{\n  \"format\": \"toyMC-columnar-2\",\n  \"tables\": {\n";
+  const std::vector<Column>* tables[] = { &fEventColumns, &fStepColumns };
+  const char* names[] = { "event", "step" };
+  long long rows[] = { fEventRows, fStepRows };
+  for ( G4int t = 0; t < 2; ++t ) {
+    out << "    \"" << names[t] << "\": { \"rows\": " << rows[t]
+        << ", \"columns\": [";
+    for ( std::size_t i = 0; i < tables[t]->size(); ++i ) {
+      const Column& column = (*tables[t])[i];
+      out << ( i ? ", " : "" ) << "[\"" << column.name << "\", \""
+          << order << column.dtype << "\"]";
+    }
+    out << "] }" << ( t == 0 ? "," : "" ) << "\n";
+  }
+  out << "  },\n  \"index\": {\n"
+      << "    \"step_begin\": \"" << order << "i8\",\n"
+      << "    \"event_row\": [[\"eventID\", \"" << order << "i8\"], [\"row\", \""
+      << order << "i8\"]]\n  }\n}\n";
+}
+
+//....oooOO0OOooo........oooOO0OOooo........oooOO0OOooo........oooOO0OOooo......
@@ -2,6 +2,9 @@
 /// \brief Implementation of the DetectorConstruction class
 
 #include "DetectorConstruction.hh"
+#include "DetectorSD.hh"
+#include "ScintillatorSD.hh"
+#include "OpticalBoxModel.hh"
 
 #include "G4RunManager.hh"
 #include "G4NistManager.hh"
@@ -20,24 +23,251 @@
 #include <G4SubtractionSolid.hh>
 #include "G4LogicalVolume.hh"
 #include "G4PVPlacement.hh"
+#include "G4Region.hh"
+#include "G4RegionStore.hh"
+#include "G4ProductionCuts.hh"
 #include <G4RotationMatrix.hh>
 #include "G4SystemOfUnits.hh"
 #include <G4VisAttributes.hh>
+#include "G4SDManager.hh"
+#include "G4GenericMessenger.hh"
+#include "G4UImanager.hh"
+#include "G4UnitsTable.hh"
+
+#include <algorithm>
+#include <cmath>
+#include <vector>
 
 #define pi 3.14159265359
 
 //....oooOO0OOooo........oooOO0OOooo........oooOO0OOooo........oooOO0OOooo......
 
 DetectorConstruction::DetectorConstruction()
-: G4VUserDetectorConstruction()
+: G4VUserDetectorConstruction(),
+  fScoringVolume(0),
+  fLogicWorld(0),
+  fLogicScintillator(0),
+  fLogicDetector(0),
+  fPDE(1.),
+  fYieldPrescale(false),
+  fFastOptics(false),
+  fFastBatchSize(4096),
+  fCheckOverlaps(true),
+  fWorldMaterial(0),
+  fScintMaterial(0),
+  fScintSize(6.0*cm),
+  fPMTRadius(2.54*cm),
+  fPMTGap(1.*mm),
+  fSolidScintillator(0),
+  fSolidDetector(0),
+  fPhysSource(0),
+  fPhysDetector(0),
+  fMessenger(0),
+  fDetMessenger(0)
 {
   DefineMaterial();
+  fWorldMaterial = Al;
+  fScintMaterial = EJ200;
+
+  fMessenger = new G4GenericMessenger(this, "/toy/optics/", "Optical settings");
+  auto& pdeCmd = fMessenger->DeclareProperty("pde", fPDE,
+    "Photon detection efficiency of the Detector");
+  pdeCmd.SetParameterName("pde", false);
+  pdeCmd.SetRange("pde>0. && pde<=1.");
+  pdeCmd.SetToBeBroadcasted(false);
+  auto& prescaleCmd = fMessenger->DeclareProperty("prescale", fYieldPrescale,
+    "Apply the PDE to the scintillation yield instead of to the detected"
+    " photons: fewer photons are tracked for the same detected distribution");
+  prescaleCmd.SetParameterName("prescale", false);
+  prescaleCmd.SetToBeBroadcasted(false);
+  auto& fastBoxCmd = fMessenger->DeclareProperty("fastBox", fFastOptics,
+    "Transport optical photons in the scintillator box with the batched"
+    " analytic model (OpticalBoxModel) instead of step by step");
+  fastBoxCmd.SetParameterName("fastBox", false);
+  fastBoxCmd.SetToBeBroadcasted(false);
+  auto& fastBatchCmd = fMessenger->DeclareProperty("fastBatch", fFastBatchSize,
+    "Photons collected before the analytic model traces a batch");
+  fastBatchCmd.SetParameterName("fastBatch", false);
+  fastBatchCmd.SetRange("fastBatch>0");
+  fastBatchCmd.SetToBeBroadcasted(false);
+
+  // Geometry and materials are shared, only the master changes them
+  fDetMessenger = new G4GenericMessenger(this, "/toy/det/", "Detector setup");
+  auto& materialCmd = fDetMessenger->DeclareMethod("scintMaterial",
+    &DetectorConstruction::SetScintillatorMaterial, "Scintillator material");
+  materialCmd.SetParameterName("material", false);
+  materialCmd.SetCandidates("EJ200 EJ276");
+  materialCmd.SetToBeBroadcasted(false);
+  auto& worldCmd = fDetMessenger->DeclareMethod("worldMaterial",
+    &DetectorConstruction::SetWorldMaterial,
+    "World material: Al (no RINDEX, photons die at the scintillator surface)"
+    " or Air (photons leave the scintillator and reach the Detector)");
+  worldCmd.SetParameterName("material", false);
+  worldCmd.SetCandidates("Al Air");
+  worldCmd.SetToBeBroadcasted(false);
+  auto& sizeCmd = fDetMessenger->DeclareMethodWithUnit("scintSize", "cm",
+    &DetectorConstruction::SetScintillatorSize, "Edge of the scintillator cube");
+  sizeCmd.SetParameterName("size", false);
+  sizeCmd.SetRange("size>0.");
+  sizeCmd.SetToBeBroadcasted(false);
+  auto& radiusCmd = fDetMessenger->DeclareMethodWithUnit("pmtRadius", "cm",
+    &DetectorConstruction::SetPMTRadius, "Radius of the Detector (PMT window)");
+  radiusCmd.SetParameterName("radius", false);
+  radiusCmd.SetRange("radius>0.");
+  radiusCmd.SetToBeBroadcasted(false);
+  auto& gapCmd = fDetMessenger->DeclareMethodWithUnit("pmtGap", "mm",
+    &DetectorConstruction::SetPMTGap,
+    "Distance between the scintillator and the Detector face");
+  gapCmd.SetParameterName("gap", false);
+  gapCmd.SetRange("gap>=0.");
+  gapCmd.SetToBeBroadcasted(false);
+  auto& reflectivityCmd = fDetMessenger->DeclareMethod("reflectivity",
+    &DetectorConstruction::SetSurfaceReflectivity,
+    "REFLECTIVITY of the scintillator and Detector surfaces");
+  reflectivityCmd.SetParameterName("reflectivity", false);
+  reflectivityCmd.SetRange("reflectivity>=0. && reflectivity<=1.");
+  reflectivityCmd.SetToBeBroadcasted(false);
+  auto& efficiencyCmd = fDetMessenger->DeclareMethod("efficiency",
+    &DetectorConstruction::SetSurfaceEfficiency,
+    "EFFICIENCY of the scintillator and Detector surfaces");
+  efficiencyCmd.SetParameterName("efficiency", false);
+  efficiencyCmd.SetRange("efficiency>=0. && efficiency<=1.");
+  efficiencyCmd.SetToBeBroadcasted(false);
 }
 
 //....oooOO0OOooo........oooOO0OOooo........oooOO0OOooo........oooOO0OOooo......
 
 DetectorConstruction::~DetectorConstruction()
-{ }
+{
+  delete fMessenger;
+  delete fDetMessenger;
+}
+
+//....oooOO0OOooo........oooOO0OOooo........oooOO0OOooo........oooOO0OOooo......
+
+void DetectorConstruction::SetScintillatorMaterial(const G4String& name)
+{
+  G4Material* material = ( name == "EJ276" ) ? EJ276 : EJ200;
+  if ( material == fScintMaterial ) return;
+  fScintMaterial = material;
+  if ( fLogicScintillator ) {
+    // After initialization: the material-cuts couples and the physics
+    // tables need an update
+    fLogicScintillator->SetMaterial(fScintMaterial);
+    G4UImanager::GetUIpointer()->ApplyCommand("/run/physicsModified");
+  }
+}
+
+//....oooOO0OOooo........oooOO0OOooo........oooOO0OOooo........oooOO0OOooo......
+
+void DetectorConstruction::SetWorldMaterial(const G4String& name)
+{
+  G4Material* material = ( name == "Air" ) ? Air : Al;
+  if ( material == fWorldMaterial ) return;
+  fWorldMaterial = material;
+  if ( fLogicWorld ) {
+    fLogicWorld->SetMaterial(fWorldMaterial);
+    G4UImanager::GetUIpointer()->ApplyCommand("/run/physicsModified");
+  }
+}
+
+//....oooOO0OOooo........oooOO0OOooo........oooOO0OOooo........oooOO0OOooo......
+
+void DetectorConstruction::SetScintillatorSize(G4double size)
+{
+  G4double old = fScintSize;
+  fScintSize = size;
+  if ( ! UpdateGeometry() ) fScintSize = old;
+}
+
+//....oooOO0OOooo........oooOO0OOooo........oooOO0OOooo........oooOO0OOooo......
+
+void DetectorConstruction::SetPMTRadius(G4double radius)
+{
+  G4double old = fPMTRadius;
+  fPMTRadius = radius;
+  if ( ! UpdateGeometry() ) fPMTRadius = old;
+}
+
+//....oooOO0OOooo........oooOO0OOooo........oooOO0OOooo........oooOO0OOooo......
+
+void DetectorConstruction::SetPMTGap(G4double gap)
+{
+  G4double old = fPMTGap;
+  fPMTGap = gap;
+  if ( ! UpdateGeometry() ) fPMTGap = old;
+}
+
+//....oooOO0OOooo........oooOO0OOooo........oooOO0OOooo........oooOO0OOooo......
+
+G4bool DetectorConstruction::UpdateGeometry()
+{
+  // Before Construct() the new values are simply used by it
+  if ( ! fSolidScintillator ) return true;
+
+  G4double sourceHalfLength = static_cast<const G4Tubs*>(
+    fPhysSource->GetLogicalVolume()->GetSolid())->GetZHalfLength();
+  G4double detectorHalfLength = fSolidDetector->GetZHalfLength();
+  G4double worldHalfSize
+    = static_cast<const G4Box*>(fPhysSource->GetMotherLogical()->GetSolid())
+      ->GetXHalfLength();
+  if ( 0.5*fScintSize + 2.*sourceHalfLength > worldHalfSize
+       || 0.5*fScintSize + fPMTGap + 2.*detectorHalfLength > worldHalfSize
+       || std::max(0.5*fScintSize, fPMTRadius) > worldHalfSize ) {
+    G4ExceptionDescription msg;
+    msg << "Scintillator size " << G4BestUnit(fScintSize, "Length")
+        << ", PMT radius " << G4BestUnit(fPMTRadius, "Length")
+        << " and gap " << G4BestUnit(fPMTGap, "Length")
+        << " do not fit in the world; geometry not changed.";
+    G4Exception("DetectorConstruction::UpdateGeometry()", "toyMC_det001",
+                JustWarning, msg);
+    return false;
+  }
+
+  fSolidScintillator->SetXHalfLength(0.5*fScintSize);
+  fSolidScintillator->SetYHalfLength(0.5*fScintSize);
+  fSolidScintillator->SetZHalfLength(0.5*fScintSize);
+  fSolidDetector->SetOuterRadius(fPMTRadius);
+  fPhysSource->SetTranslation(
+    G4ThreeVector(0., sourceHalfLength + 0.5*fScintSize, 0.));
+  fPhysDetector->SetTranslation(
+    G4ThreeVector(0., -0.5*fScintSize - fPMTGap - detectorHalfLength, 0.));
+  if ( fCheckOverlaps ) {
+    fPhysSource->CheckOverlaps();
+    fPhysDetector->CheckOverlaps();
+  }
+  // Only the voxels of the geometry are rebuilt, not the physics
+  G4RunManager::GetRunManager()->GeometryHasBeenModified();
+  return true;
+}
+
+//....oooOO0OOooo........oooOO0OOooo........oooOO0OOooo........oooOO0OOooo......
+
+void DetectorConstruction::SetSurfaceReflectivity(G4double reflectivity)
+{
+  SetSurfaceProperty("REFLECTIVITY", reflectivity);
+}
+
+//....oooOO0OOooo........oooOO0OOooo........oooOO0OOooo........oooOO0OOooo......
+
+void DetectorConstruction::SetSurfaceEfficiency(G4double efficiency)
+{
+  SetSurfaceProperty("EFFICIENCY", efficiency);
+}
+
+//....oooOO0OOooo........oooOO0OOooo........oooOO0OOooo........oooOO0OOooo......
+
+void DetectorConstruction::SetSurfaceProperty(const G4String& name,
+                                              G4double value)
+{
+  // The boundary process reads the surface table at every step, so the new
+  // value applies from the next photon on
+  G4MaterialPropertyVector* property
+    = stickToAir->GetMaterialPropertiesTable()->GetProperty(name);
+  for ( std::size_t i = 0; i < property->GetVectorLength(); ++i ) {
+    property->PutValue(i, value);
+  }
+}
 
 //....oooOO0OOooo........oooOO0OOooo........oooOO0OOooo........oooOO0OOooo......
 void DetectorConstruction::DefineMaterial()
@@ -124,6 +354,9 @@ void DetectorConstruction::DefineMaterial()
   mptEJ200->AddConstProperty("YIELDRATIO", 1.0);                // 快速成分比例
   
   EJ200->SetMaterialPropertiesTable(mptEJ200);
+  fNominalYield[EJ200]
+    = std::make_pair(mptEJ200->GetConstProperty("SCINTILLATIONYIELD"),
+                     mptEJ200->GetConstProperty("RESOLUTIONSCALE"));
 
   // EJ-200 -> Air
   G4double ePhoton[] = {2.00*eV, 9.75*eV};
@@ -214,19 +447,45 @@ void DetectorConstruction::DefineMaterial()
 
   // 绑定到材料
   EJ276->SetMaterialPropertiesTable(mpt);
+  fNominalYield[EJ276]
+    = std::make_pair(mpt->GetConstProperty("SCINTILLATIONYIELD"),
+                     mpt->GetConstProperty("RESOLUTIONSCALE"));
 
   G4cout << "EJ276 : density " <<  EJ276->GetDensity()/(g / cm3) << " , "
          << "NbOfAtomsPerVolume " << EJ276->GetTotNbOfAtomsPerVolume()/(1. / cm3) << G4endl;
 }
+
+//....oooOO0OOooo........oooOO0OOooo........oooOO0OOooo........oooOO0OOooo......
+
+void DetectorConstruction::UpdateScintillationYield() const
+{
+  // Keeping each photon with probability eps turns Poisson(Y*E) into
+  // Poisson(eps*Y*E), so with prescaling we generate eps*Y and count every
+  // photon. G4Scintillation samples the number of photons with variance
+  // (RESOLUTIONSCALE)^2*mean; the thinned variance is
+  // eps^2*RS^2*Y*E + eps*(1-eps)*Y*E, hence RS'^2 = eps*RS^2 + 1 - eps.
+  G4double eps = fYieldPrescale ? fPDE : 1.;
+  for ( auto& nominal : fNominalYield ) {
+    G4MaterialPropertiesTable* mpt = nominal.first->GetMaterialPropertiesTable();
+    G4double yield = nominal.second.first;
+    G4double resolution = nominal.second.second;
+    mpt->AddConstProperty("SCINTILLATIONYIELD", eps*yield);
+    mpt->AddConstProperty("RESOLUTIONSCALE",
+                          std::sqrt(eps*resolution*resolution + 1. - eps));
+  }
+}
+
+//....oooOO0OOooo........oooOO0OOooo........oooOO0OOooo........oooOO0OOooo......
+
 G4VPhysicalVolume* DetectorConstruction::Construct()
 {  
   
   // Scintillator Box
   //
-  G4double  ScintillatorSize= 6.0*cm;
+  G4double  ScintillatorSize= fScintSize;
   // Option to switch on/off checking of volumes overlaps
   //
-  G4bool checkOverlaps = true;
+  G4bool checkOverlaps = fCheckOverlaps;
  
   // World
   G4double world_sizeXYZ = 20.0*cm;
@@ -237,8 +496,9 @@ G4VPhysicalVolume* DetectorConstruction::Construct()
       
   G4LogicalVolume* logicWorld =                         
     new G4LogicalVolume(solidWorld,          //its solid
-                        Al,           //its material
+                        fWorldMaterial,      //its material, Al or Air
                         "World");            //its name
+  fLogicWorld = logicWorld;
                                    
   G4VPhysicalVolume* physWorld = 
     new G4PVPlacement(0,                     //no rotation
@@ -255,11 +515,13 @@ G4VPhysicalVolume* DetectorConstruction::Construct()
   G4Box* solidScintillator =    
     new G4Box("solidScintillator",                    //its name
         0.5*ScintillatorSize, 0.5*ScintillatorSize, 0.5*ScintillatorSize); //its size
+  fSolidScintillator = solidScintillator;
       
   G4LogicalVolume* logicScintillator =                         
     new G4LogicalVolume(solidScintillator,            //its solid
-                        EJ200,             //its material, Use EJ200 or EJ276
+                        fScintMaterial,    //its material, EJ200 or EJ276
                         "logicScintillator");         //its name
+  fLogicScintillator = logicScintillator;
                
   G4VPhysicalVolume* phyScint =  
   new G4PVPlacement(0,                       //no rotation
@@ -290,6 +552,7 @@ G4VPhysicalVolume* DetectorConstruction::Construct()
                         Air,             //its material
                         "SourceCylinder");         //its name
                
+  fPhysSource =
   new G4PVPlacement(CylinderRotate,                       //no rotation
                     G4ThreeVector(0,SourceHalfLength+ScintillatorSize*0.5,0),         //at (0,0,0)
                     logicSourceCylinder,                //its logical volume
@@ -300,28 +563,76 @@ G4VPhysicalVolume* DetectorConstruction::Construct()
                     checkOverlaps);          //overlaps checking      
 
   //Detector===============================================================  
-  G4double PMTRadius = 2.54*cm;
+  G4double PMTRadius = fPMTRadius;
+  G4double DetectorHalfLength = 1*cm;
   G4Tubs* solidDetector =    
     new G4Tubs("solidDetector",                    //its name
-        0,PMTRadius, 1*cm,  0.*deg, 360.*deg); //its size
+        0,PMTRadius, DetectorHalfLength,  0.*deg, 360.*deg); //its size
+  fSolidDetector = solidDetector;
   G4LogicalVolume* logicDetector =                         
     new G4LogicalVolume(solidDetector,         //its solid
                         Air,          //its material
                         "Detector");           //its name
+  fLogicDetector = logicDetector;
 
   G4VPhysicalVolume* phyDetector =
   new G4PVPlacement(CylinderRotate,                       //no rotation
-                    G4ThreeVector(0,-ScintillatorSize*0.5-1.1*cm,0),   //at position
+                    G4ThreeVector(0,-ScintillatorSize*0.5-fPMTGap-DetectorHalfLength,0),   //at position
                     logicDetector,             //its logical volume
                     "Detector",                //its name
                     logicWorld,                //its mother volume  is contanier
                     false,                   //no boolean operation
                     0,                       //copy number
                     checkOverlaps);          //overlaps checking
+  fPhysDetector = phyDetector;
 
   new G4LogicalBorderSurface("EJ200WorldSurface",phyDetector, physWorld, stickToAir);
 
+  DefineRegions(logicSourceCylinder);
+
   return physWorld;
 }
 
 //....oooOO0OOooo........oooOO0OOooo........oooOO0OOooo........oooOO0OOooo......
+
+void DetectorConstruction::DefineRegions(G4LogicalVolume* logicSource)
+{
+  // Own cuts for each region, so that /run/setCut only changes the World
+  std::pair<G4String, std::vector<G4LogicalVolume*> > regions[] = {
+    { "Scintillator", { fLogicScintillator, fLogicDetector } },
+    { "Source", { logicSource } }
+  };
+  for ( const auto& entry : regions ) {
+    G4Region* region
+      = G4RegionStore::GetInstance()->GetRegion(entry.first, false);
+    if ( ! region ) {
+      region = new G4Region(entry.first);
+      auto cuts = new G4ProductionCuts;
+      cuts->SetProductionCut(0.7*mm);
+      region->SetProductionCuts(cuts);
+    }
+    for ( auto logical : entry.second ) region->AddRootLogicalVolume(logical);
+  }
+}
+
+//....oooOO0OOooo........oooOO0OOooo........oooOO0OOooo........oooOO0OOooo......
+
+void DetectorConstruction::ConstructSDandField()
+{
+  // Sensitive detectors are thread-local, so they are created here and not
+  // in Construct(), which is only called on the master.
+  DetectorSD* detectorSD = new DetectorSD("DetectorSD", "DetectorHitsCollection");
+  G4SDManager::GetSDMpointer()->AddNewDetector(detectorSD);
+  fLogicDetector->SetSensitiveDetector(detectorSD);
+
+  ScintillatorSD* scintillatorSD
+    = new ScintillatorSD("ScintillatorSD", "ScintillatorHitsCollection");
+  G4SDManager::GetSDMpointer()->AddNewDetector(scintillatorSD);
+  fLogicScintillator->SetSensitiveDetector(scintillatorSD);
+
+  // Thread-local as well; only active with /toy/optics/fastBox true
+  new OpticalBoxModel(G4RegionStore::GetInstance()->GetRegion("Scintillator"),
+                      fLogicScintillator, this);
+}
+
+//....oooOO0OOooo........oooOO0OOooo........oooOO0OOooo........oooOO0OOooo......
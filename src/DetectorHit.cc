@@ -0,0 +1,28 @@
+/// \file DetectorHit.cc
+/// \brief Implementation of the DetectorHit class
+
+#include "DetectorHit.hh"
+
+G4ThreadLocal G4Allocator<DetectorHit>* DetectorHitAllocator = 0;
+
+//....oooOO0OOooo........oooOO0OOooo........oooOO0OOooo........oooOO0OOooo......
+
+DetectorHit::DetectorHit()
+ : G4VHit(),
+   fParticle(0),
+   fTrackID(-1),
+   fParentID(-1),
+   fEnergy(0.),
+   fEdep(0.),
+   fTime(0.),
+   fEntering(false)
+{
+  for ( G4int i = 0; i < 3; ++i ) fPrePos[i] = fPostPos[i] = 0.;
+}
+
+//....oooOO0OOooo........oooOO0OOooo........oooOO0OOooo........oooOO0OOooo......
+
+DetectorHit::~DetectorHit()
+{}
+
+//....oooOO0OOooo........oooOO0OOooo........oooOO0OOooo........oooOO0OOooo......
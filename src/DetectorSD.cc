@@ -0,0 +1,64 @@
+/// \file DetectorSD.cc
+/// \brief Implementation of the DetectorSD class
+
+#include "DetectorSD.hh"
+
+#include "G4HCofThisEvent.hh"
+#include "G4Step.hh"
+#include "G4SDManager.hh"
+
+//....oooOO0OOooo........oooOO0OOooo........oooOO0OOooo........oooOO0OOooo......
+
+DetectorSD::DetectorSD(const G4String& name,
+                       const G4String& hitsCollectionName)
+ : G4VSensitiveDetector(name),
+   fHitsCollection(0)
+{
+  collectionName.insert(hitsCollectionName);
+}
+
+//....oooOO0OOooo........oooOO0OOooo........oooOO0OOooo........oooOO0OOooo......
+
+DetectorSD::~DetectorSD()
+{}
+
+//....oooOO0OOooo........oooOO0OOooo........oooOO0OOooo........oooOO0OOooo......
+
+void DetectorSD::Initialize(G4HCofThisEvent* hce)
+{
+  // Create hits collection
+  fHitsCollection
+    = new DetectorHitsCollection(SensitiveDetectorName, collectionName[0]);
+
+  // Add this collection in hce
+  G4int hcID
+    = G4SDManager::GetSDMpointer()->GetCollectionID(collectionName[0]);
+  hce->AddHitsCollection(hcID, fHitsCollection);
+}
+
+//....oooOO0OOooo........oooOO0OOooo........oooOO0OOooo........oooOO0OOooo......
+
+G4bool DetectorSD::ProcessHits(G4Step* step, G4TouchableHistory*)
+{
+  // Steps without energy deposit are kept: optical photons crossing the
+  // detector deposit nothing but are exactly what we want to count.
+  const G4StepPoint* preStepPoint = step->GetPreStepPoint();
+  const G4Track* track = step->GetTrack();
+
+  DetectorHit* hit = new DetectorHit();
+  hit->SetParticle(track->GetDefinition());
+  hit->SetTrackID(track->GetTrackID());
+  hit->SetParentID(track->GetParentID());
+  hit->SetEnergy(preStepPoint->GetKineticEnergy());
+  hit->SetEdep(step->GetTotalEnergyDeposit());
+  hit->SetTime(preStepPoint->GetGlobalTime());
+  hit->SetEntering(preStepPoint->GetStepStatus() == fGeomBoundary);
+  hit->SetPrePos(preStepPoint->GetPosition());
+  hit->SetPostPos(step->GetPostStepPoint()->GetPosition());
+
+  fHitsCollection->insert(hit);
+
+  return true;
+}
+
+//....oooOO0OOooo........oooOO0OOooo........oooOO0OOooo........oooOO0OOooo......
@@ -3,13 +3,60 @@
 
 #include "EventAction.hh"
 #include "RunAction.hh"
+#include "DetectorHit.hh"
+#include "ScintillatorHit.hh"
+#include "LightMap.hh"
+#include "DetectorConstruction.hh"
+#include "Telemetry.hh"
+#include "PMTDigitizer.hh"
+#include "Trigger.hh"
+#include "ResponseMatrix.hh"
+#include "AsyncWriter.hh"
 
 #include "G4Event.hh"
 #include "G4RunManager.hh"
+#include "G4SDManager.hh"
+#include "G4HCofThisEvent.hh"
+#include "G4OpticalPhoton.hh"
+#include "G4PrimaryVertex.hh"
+#include "G4PrimaryParticle.hh"
+#include "G4SystemOfUnits.hh"
+#include "Randomize.hh"
+#include "g4root.hh"
+
+#include <algorithm>
+
+namespace {
+  // One row of the step output, energies in keV
+  StepRecord MakeStepRecord(const DetectorHit* hit, const EventRecord& event)
+  {
+    StepRecord record;
+    G4ThreeVector pre = hit->GetPrePos();
+    G4ThreeVector post = hit->GetPostPos();
+    record.energy = hit->GetEnergy()/keV;
+    for ( G4int k = 0; k < 3; ++k ) {
+      record.pre[k] = pre[k];
+      record.post[k] = post[k];
+    }
+    record.pdg = hit->GetParticle()->GetPDGEncoding();
+    record.eventID = event.eventID;
+    record.trackID = hit->GetTrackID();
+    record.parentID = hit->GetParentID();
+    record.edep = hit->GetEdep()/keV;
+    record.weight = event.weight;
+    return record;
+  }
+}
 
 //....oooOO0OOooo........oooOO0OOooo........oooOO0OOooo........oooOO0OOooo......
 
 EventAction::EventAction(RunAction* runAction)
+: fRunAction(runAction),
+  fDetectorHCID(-1),
+  fScintillatorHCID(-1),
+  fOpticalPhoton(G4OpticalPhoton::OpticalPhotonDefinition()),
+  fNSteps(0),
+  fNPhotons(0)
 {} 
 
 //....oooOO0OOooo........oooOO0OOooo........oooOO0OOooo........oooOO0OOooo......
@@ -29,8 +76,192 @@ void EventAction::BeginOfEventAction(const G4Event* pEvent)
 
 //....oooOO0OOooo........oooOO0OOooo........oooOO0OOooo........oooOO0OOooo......
 
-void EventAction::EndOfEventAction(const G4Event*)
+void EventAction::EndOfEventAction(const G4Event* event)
 {   
+  Telemetry::Instance()->EventDone(fNSteps, fNPhotons);
+  fNSteps = 0;
+  fNPhotons = 0;
+
+  // Events aborted by the stacking action are not written, neither are the
+  // empty events that end a replay
+  if ( event->IsAborted() || event->GetNumberOfPrimaryVertex() == 0 ) return;
+
+  if ( fDetectorHCID < 0 ) {
+    auto sdManager = G4SDManager::GetSDMpointer();
+    fDetectorHCID = sdManager->GetCollectionID("DetectorHitsCollection");
+    fScintillatorHCID = sdManager->GetCollectionID("ScintillatorHitsCollection");
+  }
+  G4HCofThisEvent* hce = event->GetHCofThisEvent();
+  if ( ! hce ) return;
+  auto detectorHC
+    = static_cast<DetectorHitsCollection*>(hce->GetHC(fDetectorHCID));
+  auto scintillatorHC
+    = static_cast<ScintillatorHitsCollection*>(hce->GetHC(fScintillatorHCID));
+  if ( ! detectorHC || ! scintillatorHC ) return;
+
+  fRecord = EventRecord();
+  fRecord.eventID = event->GetEventID();
+
+  // Primaries; the event weight is the product of their weights (direction
+  // biasing of the generator)
+  G4double primaryEnergy = 0.;
+  G4double weight = 1.;
+  for ( G4int iv = 0; iv < event->GetNumberOfPrimaryVertex(); ++iv ) {
+    const G4PrimaryVertex* vertex = event->GetPrimaryVertex(iv);
+    for ( G4int ip = 0; ip < vertex->GetNumberOfParticle(); ++ip ) {
+      const G4PrimaryParticle* primary = vertex->GetPrimary(ip);
+      if ( iv == 0 && ip == 0 ) fRecord.primaryPDG = primary->GetPDGcode();
+      primaryEnergy += primary->GetKineticEnergy();
+      weight *= primary->GetWeight();
+    }
+  }
+  fRecord.primaryEnergy = primaryEnergy/keV;
+  fRecord.weight = weight;
+
+  // Detected photons: optical photons entering the Detector, or in fast
+  // mode photons sampled from the light map for each deposit
+  fPhotonTimes.clear();
+  std::size_t nofHits = detectorHC->entries();
+  for ( std::size_t i = 0; i < nofHits; ++i ) {
+    const DetectorHit* hit = (*detectorHC)[i];
+    if ( hit->GetParticle() == fOpticalPhoton && hit->IsEntering() ) {
+      fPhotonTimes.push_back(hit->GetTime());
+    }
+  }
+
+  // Deposit in the scintillator
+  const LightMap* lightMap = fRunAction->GetLightMap();
+  G4bool fastLight = ( lightMap->GetMode() == LightMap::kFast );
+  G4double edep = 0.;
+  std::size_t nofScintHits = scintillatorHC->entries();
+  for ( std::size_t i = 0; i < nofScintHits; ++i ) {
+    const ScintillatorHit* hit = (*scintillatorHC)[i];
+    edep += hit->GetEdep();
+    if ( fastLight ) {
+      lightMap->SamplePhotons(hit->GetPos(), hit->GetEdep(), hit->GetTime(),
+                              fPhotonTimes);
+    }
+  }
+  fRecord.edep = edep/keV;
+
+  // Photon detection efficiency, unless it was already applied to the
+  // scintillation yield (and to the Cerenkov photons by the stacking action)
+  // or we are measuring the bare light collection
+  auto detector = static_cast<const DetectorConstruction*>(
+    G4RunManager::GetRunManager()->GetUserDetectorConstruction());
+  G4double pde = detector->GetPDE();
+  if ( pde < 1. && ! detector->GetYieldPrescale()
+       && lightMap->GetMode() != LightMap::kCalibrate ) {
+    auto last = std::remove_if(fPhotonTimes.begin(), fPhotonTimes.end(),
+      [pde](G4double) { return G4UniformRand() >= pde; });
+    fPhotonTimes.erase(last, fPhotonTimes.end());
+  }
+
+  // Calibration: the primary vertex is a burst of optical photons
+  if ( lightMap->GetMode() == LightMap::kCalibrate
+       && event->GetNumberOfPrimaryVertex() > 0 ) {
+    const G4PrimaryVertex* vertex = event->GetPrimaryVertex(0);
+    std::vector<G4double> arrivalTimes(fPhotonTimes);
+    for ( auto& t : arrivalTimes ) t -= vertex->GetT0();
+    fRunAction->GetLightMap()->Fill(vertex->GetPosition(),
+                                    vertex->GetNumberOfParticle(), arrivalTimes);
+  }
+  fRecord.nPhotons = fPhotonTimes.size();
+  if ( ! fPhotonTimes.empty() ) {
+    G4double sum = 0.;
+    for ( auto t : fPhotonTimes ) sum += t;
+    fRecord.firstTime
+      = *std::min_element(fPhotonTimes.begin(), fPhotonTimes.end())/ns;
+    fRecord.meanTime = sum/fPhotonTimes.size()/ns;
+  }
+
+  // PMT pulse
+  PMTDigitizer* digitizer = fRunAction->GetDigitizer();
+  if ( digitizer->IsEnabled() ) {
+    digitizer->Digitize(fPhotonTimes);
+    fRecord.qTotal = digitizer->GetQTotal();
+    fRecord.qTail = digitizer->GetQTail();
+  }
+  else {
+    digitizer->GetWaveform().clear();
+  }
+
+  auto analysisManager = G4AnalysisManager::Instance();
+  const G4double w = fRecord.weight;
+  analysisManager->FillH1(RunAction::kEdepH1, fRecord.edep, w);
+  analysisManager->FillH1(RunAction::kNPhotonsH1, fRecord.nPhotons, w);
+  analysisManager->FillH2(RunAction::kNPhotonsEdepH2, fRecord.edep,
+                          fRecord.nPhotons, w);
+  for ( auto t : fPhotonTimes ) {
+    analysisManager->FillH1(RunAction::kTimeH1, t/ns, w);
+  }
+  ResponseMatrix* responseMatrix = fRunAction->GetResponseMatrix();
+  if ( responseMatrix->IsEnabled() ) {
+    responseMatrix->Fill(fRecord.eventID, fRecord.nPhotons, w);
+  }
+
+  // Events failing the trigger are counted, but get no rows
+  if ( ! fRunAction->GetTrigger()->Accept(fPhotonTimes, edep) ) return;
+  if ( fRunAction->GetOutputMode() == RunAction::kHistOutput ) return;
+
+  if ( fRunAction->UsesAsyncWriter() ) {
+    OutputBuffer* buffer = fRunAction->GetOutputBuffer();
+    buffer->Add(fRecord);
+    if ( fRunAction->GetOutputMode() == RunAction::kStepOutput ) {
+      for ( std::size_t i = 0; i < nofHits; ++i ) {
+        buffer->Add(MakeStepRecord((*detectorHC)[i], fRecord));
+      }
+    }
+    buffer->EndEvent();
+    return;
+  }
+
+  const G4int id = RunAction::kEventNtuple;
+  analysisManager->FillNtupleIColumn(id, 0, fRecord.eventID);
+  analysisManager->FillNtupleIColumn(id, 1, fRecord.nPhotons);
+  analysisManager->FillNtupleFColumn(id, 2, fRecord.firstTime);
+  analysisManager->FillNtupleFColumn(id, 3, fRecord.meanTime);
+  analysisManager->FillNtupleFColumn(id, 4, fRecord.edep);
+  analysisManager->FillNtupleFColumn(id, 5, fRecord.primaryEnergy);
+  analysisManager->FillNtupleIColumn(id, 6, fRecord.primaryPDG);
+  analysisManager->FillNtupleFColumn(id, 7, fRecord.qTotal);
+  analysisManager->FillNtupleFColumn(id, 8, fRecord.qTail);
+  analysisManager->FillNtupleFColumn(id, 10, fRecord.weight);
+  analysisManager->AddNtupleRow(id);
+
+  if ( fRunAction->GetOutputMode() == RunAction::kStepOutput ) {
+    FillStepNtuple(event);
+  }
+}
+
+//....oooOO0OOooo........oooOO0OOooo........oooOO0OOooo........oooOO0OOooo......
+
+void EventAction::FillStepNtuple(const G4Event* event) const
+{
+  auto hitsCollection = static_cast<DetectorHitsCollection*>(
+    event->GetHCofThisEvent()->GetHC(fDetectorHCID));
+
+  // One row per step in the Detector
+  auto analysisManager = G4AnalysisManager::Instance();
+  const G4int id = RunAction::kStepNtuple;
+  std::size_t nofHits = hitsCollection->entries();
+  for ( std::size_t i = 0; i < nofHits; ++i ) {
+    StepRecord record = MakeStepRecord((*hitsCollection)[i], fRecord);
+    analysisManager->FillNtupleFColumn(id, 0, record.energy);
+    analysisManager->FillNtupleFColumn(id, 1, record.pre[0]);
+    analysisManager->FillNtupleFColumn(id, 2, record.pre[1]);
+    analysisManager->FillNtupleFColumn(id, 3, record.pre[2]);
+    analysisManager->FillNtupleFColumn(id, 4, record.post[0]);
+    analysisManager->FillNtupleFColumn(id, 5, record.post[1]);
+    analysisManager->FillNtupleFColumn(id, 6, record.post[2]);
+    analysisManager->FillNtupleIColumn(id, 7, record.pdg);
+    analysisManager->FillNtupleIColumn(id, 8, record.eventID);
+    analysisManager->FillNtupleIColumn(id, 9, record.trackID);
+    analysisManager->FillNtupleIColumn(id, 10, record.parentID);
+    analysisManager->FillNtupleFColumn(id, 11, record.edep);
+    analysisManager->FillNtupleFColumn(id, 12, record.weight);
+    analysisManager->AddNtupleRow(id);
+  }
 }
 
 //....oooOO0OOooo........oooOO0OOooo........oooOO0OOooo........oooOO0OOooo......
@@ -0,0 +1,28 @@
+/// \file LeanPhysicsList.cc
+/// \brief Implementation of the LeanPhysicsList class
+
+#include "LeanPhysicsList.hh"
+
+#include "G4EmStandardPhysics_option4.hh"
+#include "G4EmLivermorePhysics.hh"
+#include "G4DecayPhysics.hh"
+#include "G4SystemOfUnits.hh"
+
+//....oooOO0OOooo........oooOO0OOooo........oooOO0OOooo........oooOO0OOooo......
+
+LeanPhysicsList::LeanPhysicsList(const G4String& emName)
+ : G4VModularPhysicsList()
+{
+  SetDefaultCutValue(0.7*mm);
+  if ( emName == "livermore" ) RegisterPhysics(new G4EmLivermorePhysics());
+  else RegisterPhysics(new G4EmStandardPhysics_option4());
+  // Also constructs all particles, so GPS can still shoot any of them
+  RegisterPhysics(new G4DecayPhysics());
+}
+
+//....oooOO0OOooo........oooOO0OOooo........oooOO0OOooo........oooOO0OOooo......
+
+LeanPhysicsList::~LeanPhysicsList()
+{}
+
+//....oooOO0OOooo........oooOO0OOooo........oooOO0OOooo........oooOO0OOooo......
@@ -0,0 +1,412 @@
+/// \file LightMap.cc
+/// \brief Implementation of the LightMap class
+
+#include "LightMap.hh"
+
+#include "G4GenericMessenger.hh"
+#include "G4Material.hh"
+#include "G4MaterialPropertiesTable.hh"
+#include "G4VPhysicalVolume.hh"
+#include "G4LogicalVolume.hh"
+#include "G4Box.hh"
+#include "G4UImanager.hh"
+#include "G4StateManager.hh"
+#include "G4Threading.hh"
+#include "G4Poisson.hh"
+#include "G4SystemOfUnits.hh"
+#include "Randomize.hh"
+
+#include <algorithm>
+#include <cmath>
+#include <fstream>
+#include <sstream>
+
+//....oooOO0OOooo........oooOO0OOooo........oooOO0OOooo........oooOO0OOooo......
+
+LightMap::LightMap()
+ : G4VAccumulable("LightMap"),
+   fMode(kOff),
+   fFileName("lightmap.txt"),
+   fMessenger(0),
+   fNx(10), fNy(10), fNz(10),
+   fHasBox(false),
+   fNtBins(100),
+   fTmax(50.*ns),
+   fLoaded(false),
+   fYield(0.),
+   fFastTime(0.),
+   fSlowTime(0.),
+   fYieldRatio(1.)
+{
+  Book();
+
+  fMessenger = new G4GenericMessenger(this, "/toy/lightmap/",
+                                      "Light-collection efficiency map");
+  auto& modeCmd = fMessenger->DeclareMethod("mode", &LightMap::SetMode,
+    "off: full optical tracking; calibrate: build the map from optical photon"
+    " bursts; fast: sample detected photons from the map, no optical tracking");
+  modeCmd.SetParameterName("mode", false);
+  modeCmd.SetCandidates("off calibrate fast");
+  modeCmd.SetStates(G4State_Idle);
+
+  fMessenger->DeclareProperty("file", fFileName,
+    "File the map is saved to (calibrate) or loaded from (fast)");
+
+  auto& voxelCmd = fMessenger->DeclareMethod("voxels", &LightMap::SetNVoxels,
+    "Number of voxels along each axis of the scintillator box");
+  voxelCmd.SetParameterName("n", false);
+  voxelCmd.SetRange("n>0");
+
+  auto& binCmd = fMessenger->DeclareMethod("timeBins", &LightMap::SetNTimeBins,
+    "Number of arrival-time bins per voxel");
+  binCmd.SetParameterName("n", false);
+  binCmd.SetRange("n>0");
+
+  auto& tmaxCmd = fMessenger->DeclareMethodWithUnit("timeMax", "ns",
+    &LightMap::SetTimeMax,
+    "Upper edge of the arrival-time histogram");
+  tmaxCmd.SetParameterName("tmax", false);
+}
+
+//....oooOO0OOooo........oooOO0OOooo........oooOO0OOooo........oooOO0OOooo......
+
+LightMap::~LightMap()
+{
+  delete fMessenger;
+}
+
+//....oooOO0OOooo........oooOO0OOooo........oooOO0OOooo........oooOO0OOooo......
+
+void LightMap::SetMode(const G4String& mode)
+{
+  Mode newMode = kOff;
+  if ( mode == "calibrate" ) newMode = kCalibrate;
+  else if ( mode == "fast" ) newMode = kFast;
+  if ( newMode == fMode ) return;
+
+  // Switch optical photon production off in fast mode and back on when
+  // leaving it. Only the master issues the process commands, they are
+  // broadcast to the workers at the next /run/beamOn.
+  if ( G4Threading::IsMasterThread() && ( newMode == kFast || fMode == kFast ) ) {
+    G4String command = ( newMode == kFast ) ? "/process/inactivate " : "/process/activate ";
+    G4UImanager::GetUIpointer()->ApplyCommand(command + "Scintillation");
+    G4UImanager::GetUIpointer()->ApplyCommand(command + "Cerenkov");
+  }
+  fMode = newMode;
+  fLoaded = false;
+}
+
+//....oooOO0OOooo........oooOO0OOooo........oooOO0OOooo........oooOO0OOooo......
+
+void LightMap::SetVoxels(G4int nx, G4int ny, G4int nz)
+{
+  fNx = nx; fNy = ny; fNz = nz;
+  Book();
+}
+
+//....oooOO0OOooo........oooOO0OOooo........oooOO0OOooo........oooOO0OOooo......
+
+void LightMap::SetNVoxels(G4int n)
+{
+  SetVoxels(n, n, n);
+}
+
+//....oooOO0OOooo........oooOO0OOooo........oooOO0OOooo........oooOO0OOooo......
+
+void LightMap::SetNTimeBins(G4int nbins)
+{
+  SetTimeBins(nbins, fTmax);
+}
+
+//....oooOO0OOooo........oooOO0OOooo........oooOO0OOooo........oooOO0OOooo......
+
+void LightMap::SetTimeMax(G4double tmax)
+{
+  SetTimeBins(fNtBins, tmax);
+}
+
+//....oooOO0OOooo........oooOO0OOooo........oooOO0OOooo........oooOO0OOooo......
+
+void LightMap::SetTimeBins(G4int nbins, G4double tmax)
+{
+  fNtBins = nbins;
+  fTmax = tmax;
+  Book();
+}
+
+//....oooOO0OOooo........oooOO0OOooo........oooOO0OOooo........oooOO0OOooo......
+
+void LightMap::Book()
+{
+  std::size_t nvox = fNx*fNy*fNz;
+  fEmitted.assign(nvox, 0.);
+  fDetected.assign(nvox, 0.);
+  fTimeHist.assign(nvox*fNtBins, 0.);
+  fOverflow.assign(nvox, 0.);
+  fOverflowTime.assign(nvox, 0.);
+}
+
+//....oooOO0OOooo........oooOO0OOooo........oooOO0OOooo........oooOO0OOooo......
+
+void LightMap::Merge(const G4VAccumulable& other)
+{
+  const LightMap& otherMap = static_cast<const LightMap&>(other);
+  if ( otherMap.fEmitted.size() != fEmitted.size()
+       || otherMap.fTimeHist.size() != fTimeHist.size() ) return;
+  for ( std::size_t i = 0; i < fEmitted.size(); ++i ) {
+    fEmitted[i] += otherMap.fEmitted[i];
+    fDetected[i] += otherMap.fDetected[i];
+    fOverflow[i] += otherMap.fOverflow[i];
+    fOverflowTime[i] += otherMap.fOverflowTime[i];
+  }
+  for ( std::size_t i = 0; i < fTimeHist.size(); ++i ) {
+    fTimeHist[i] += otherMap.fTimeHist[i];
+  }
+}
+
+//....oooOO0OOooo........oooOO0OOooo........oooOO0OOooo........oooOO0OOooo......
+
+void LightMap::Reset()
+{
+  std::fill(fEmitted.begin(), fEmitted.end(), 0.);
+  std::fill(fDetected.begin(), fDetected.end(), 0.);
+  std::fill(fTimeHist.begin(), fTimeHist.end(), 0.);
+  std::fill(fOverflow.begin(), fOverflow.end(), 0.);
+  std::fill(fOverflowTime.begin(), fOverflowTime.end(), 0.);
+}
+
+//....oooOO0OOooo........oooOO0OOooo........oooOO0OOooo........oooOO0OOooo......
+
+void LightMap::SetVolume(const G4VPhysicalVolume* volume)
+{
+  const G4Box* box
+    = dynamic_cast<const G4Box*>(volume->GetLogicalVolume()->GetSolid());
+  if ( ! box ) {
+    G4ExceptionDescription ed;
+    ed << "Volume " << volume->GetName() << " is not a G4Box";
+    G4Exception("LightMap::SetVolume()", "LightMap001", FatalException, ed);
+    return;
+  }
+  G4ThreeVector half(box->GetXHalfLength(), box->GetYHalfLength(),
+                     box->GetZHalfLength());
+  fBoxMin = volume->GetObjectTranslation() - half;
+  fBoxMax = volume->GetObjectTranslation() + half;
+  fHasBox = true;
+  // A loaded map keeps the box it was calibrated on
+  if ( fLoaded ) CheckBox("LightMap::SetVolume()");
+  else {
+    fMin = fBoxMin;
+    fMax = fBoxMax;
+  }
+}
+
+//....oooOO0OOooo........oooOO0OOooo........oooOO0OOooo........oooOO0OOooo......
+
+void LightMap::CheckBox(const char* origin) const
+{
+  // The bounds are saved in mm with 6 significant digits
+  const G4double tolerance = 1.*um;
+  G4ThreeVector dmin = fMin - fBoxMin;
+  G4ThreeVector dmax = fMax - fBoxMax;
+  for ( G4int k = 0; k < 3; ++k ) {
+    if ( std::abs(dmin[k]) > tolerance || std::abs(dmax[k]) > tolerance ) {
+      G4ExceptionDescription ed;
+      ed << "Light map " << fFileName << " covers " << fMin/mm << " - "
+         << fMax/mm << " mm, the Scintillator is " << fBoxMin/mm << " - "
+         << fBoxMax/mm << " mm; calibrate a map for this geometry";
+      G4Exception(origin, "LightMap006", FatalException, ed);
+      return;
+    }
+  }
+}
+
+//....oooOO0OOooo........oooOO0OOooo........oooOO0OOooo........oooOO0OOooo......
+
+void LightMap::SetMaterial(const G4Material* material)
+{
+  G4MaterialPropertiesTable* mpt = material->GetMaterialPropertiesTable();
+  if ( ! mpt || ! mpt->ConstPropertyExists("SCINTILLATIONYIELD") ) {
+    G4ExceptionDescription ed;
+    ed << "Material " << material->GetName() << " is not a scintillator";
+    G4Exception("LightMap::SetMaterial()", "LightMap002", FatalException, ed);
+    return;
+  }
+  fYield = mpt->GetConstProperty("SCINTILLATIONYIELD");
+  fFastTime = mpt->ConstPropertyExists("FASTTIMECONSTANT")
+            ? mpt->GetConstProperty("FASTTIMECONSTANT") : 0.;
+  fSlowTime = mpt->ConstPropertyExists("SLOWTIMECONSTANT")
+            ? mpt->GetConstProperty("SLOWTIMECONSTANT") : fFastTime;
+  fYieldRatio = mpt->ConstPropertyExists("YIELDRATIO")
+              ? mpt->GetConstProperty("YIELDRATIO") : 1.;
+}
+
+//....oooOO0OOooo........oooOO0OOooo........oooOO0OOooo........oooOO0OOooo......
+
+G4int LightMap::Voxel(const G4ThreeVector& pos) const
+{
+  G4ThreeVector size = fMax - fMin;
+  G4int ix = G4int(fNx*(pos.x() - fMin.x())/size.x());
+  G4int iy = G4int(fNy*(pos.y() - fMin.y())/size.y());
+  G4int iz = G4int(fNz*(pos.z() - fMin.z())/size.z());
+  // deposits on the surface belong to the border voxel
+  ix = std::min(std::max(ix, 0), fNx-1);
+  iy = std::min(std::max(iy, 0), fNy-1);
+  iz = std::min(std::max(iz, 0), fNz-1);
+  return (ix*fNy + iy)*fNz + iz;
+}
+
+//....oooOO0OOooo........oooOO0OOooo........oooOO0OOooo........oooOO0OOooo......
+
+void LightMap::Fill(const G4ThreeVector& pos, G4int nEmitted,
+                    const std::vector<G4double>& arrivalTimes)
+{
+  G4int ivox = Voxel(pos);
+  fEmitted[ivox] += nEmitted;
+  fDetected[ivox] += arrivalTimes.size();
+  G4double* hist = &fTimeHist[ivox*fNtBins];
+  for ( auto t : arrivalTimes ) {
+    if ( t >= fTmax ) {
+      fOverflow[ivox] += 1.;
+      fOverflowTime[ivox] += t - fTmax;
+      continue;
+    }
+    hist[std::max(G4int(fNtBins*t/fTmax), 0)] += 1.;
+  }
+}
+
+//....oooOO0OOooo........oooOO0OOooo........oooOO0OOooo........oooOO0OOooo......
+
+void LightMap::Save(const G4String& fileName) const
+{
+  std::ofstream out(fileName);
+  if ( ! out ) {
+    G4ExceptionDescription ed;
+    ed << "Cannot write " << fileName;
+    G4Exception("LightMap::Save()", "LightMap003", JustWarning, ed);
+    return;
+  }
+  out << "# toyMC light map: lengths in mm, times in ns\n"
+      << "grid " << fNx << " " << fNy << " " << fNz << " "
+      << fMin.x()/mm << " " << fMin.y()/mm << " " << fMin.z()/mm << " "
+      << fMax.x()/mm << " " << fMax.y()/mm << " " << fMax.z()/mm << "\n"
+      << "time " << fNtBins << " " << fTmax/ns << " overflow\n";
+  // one line per voxel: emitted, detected, arrival-time histogram, overflow
+  // count and its summed excess time
+  for ( std::size_t i = 0; i < fEmitted.size(); ++i ) {
+    out << fEmitted[i] << " " << fDetected[i];
+    for ( G4int j = 0; j < fNtBins; ++j ) out << " " << fTimeHist[i*fNtBins + j];
+    out << " " << fOverflow[i] << " " << fOverflowTime[i]/ns << "\n";
+  }
+  G4double emitted = 0., detected = 0., overflow = 0.;
+  for ( std::size_t i = 0; i < fEmitted.size(); ++i ) {
+    emitted += fEmitted[i];
+    detected += fDetected[i];
+    overflow += fOverflow[i];
+  }
+  G4cout << "Light map saved to " << fileName << ": " << emitted
+         << " photons emitted, mean detection probability "
+         << ( emitted > 0. ? detected/emitted : 0. ) << G4endl;
+  if ( detected > 0. && overflow > 0.01*detected ) {
+    G4ExceptionDescription ed;
+    ed << 100.*overflow/detected << "% of the detected photons arrived after "
+       << fTmax/ns << " ns; they are sampled from an exponential tail. Raise"
+       << " /toy/lightmap/timeMax to histogram them.";
+    G4Exception("LightMap::Save()", "LightMap007", JustWarning, ed);
+  }
+}
+
+//....oooOO0OOooo........oooOO0OOooo........oooOO0OOooo........oooOO0OOooo......
+
+G4bool LightMap::Load(const G4String& fileName)
+{
+  std::ifstream in(fileName);
+  if ( ! in ) {
+    G4ExceptionDescription ed;
+    ed << "Cannot read light map " << fileName;
+    G4Exception("LightMap::Load()", "LightMap004", FatalException, ed);
+    return false;
+  }
+  std::string line, key;
+  G4double xmin, ymin, zmin, xmax, ymax, zmax, tmax;
+  G4int nx, ny, nz, nt;
+  std::getline(in, line);    // comment
+  in >> key >> nx >> ny >> nz >> xmin >> ymin >> zmin >> xmax >> ymax >> zmax;
+  in >> key >> nt >> tmax;
+  // Maps written before the overflow bin have nothing after tmax
+  std::getline(in, line);
+  G4bool hasOverflow = ( line.find("overflow") != std::string::npos );
+  fNx = nx; fNy = ny; fNz = nz;
+  fMin.set(xmin*mm, ymin*mm, zmin*mm);
+  fMax.set(xmax*mm, ymax*mm, zmax*mm);
+  if ( fHasBox ) CheckBox("LightMap::Load()");
+  SetTimeBins(nt, tmax*ns);
+  for ( std::size_t i = 0; i < fEmitted.size(); ++i ) {
+    in >> fEmitted[i] >> fDetected[i];
+    for ( G4int j = 0; j < fNtBins; ++j ) in >> fTimeHist[i*fNtBins + j];
+    if ( hasOverflow ) {
+      in >> fOverflow[i] >> fOverflowTime[i];
+      fOverflowTime[i] *= ns;
+    }
+  }
+  if ( ! in ) {
+    G4ExceptionDescription ed;
+    ed << "Light map " << fileName << " is truncated";
+    G4Exception("LightMap::Load()", "LightMap005", FatalException, ed);
+    return false;
+  }
+
+  // Detection probability and normalized cumulative time distribution,
+  // the overflow bin last
+  const G4int nCdf = fNtBins + 1;
+  fProbability.assign(fEmitted.size(), 0.);
+  fTimeCdf.assign(fEmitted.size()*nCdf, 0.);
+  fOverflowMean.assign(fEmitted.size(), 0.);
+  for ( std::size_t i = 0; i < fEmitted.size(); ++i ) {
+    if ( fEmitted[i] > 0. ) fProbability[i] = fDetected[i]/fEmitted[i];
+    if ( fOverflow[i] > 0. ) fOverflowMean[i] = fOverflowTime[i]/fOverflow[i];
+    G4double* cdf = &fTimeCdf[i*nCdf];
+    G4double sum = 0.;
+    for ( G4int j = 0; j < fNtBins; ++j ) {
+      sum += fTimeHist[i*fNtBins + j];
+      cdf[j] = sum;
+    }
+    sum += fOverflow[i];
+    cdf[fNtBins] = sum;
+    if ( sum > 0. ) {
+      for ( G4int j = 0; j < nCdf; ++j ) cdf[j] /= sum;
+    }
+  }
+  fLoaded = true;
+  return true;
+}
+
+//....oooOO0OOooo........oooOO0OOooo........oooOO0OOooo........oooOO0OOooo......
+
+void LightMap::SamplePhotons(const G4ThreeVector& pos, G4double edep,
+                             G4double t0,
+                             std::vector<G4double>& arrivalTimes) const
+{
+  // Emitting Poisson(Y*edep) photons and keeping each with probability p is
+  // the same as emitting Poisson(p*Y*edep) detected photons
+  G4int ivox = Voxel(pos);
+  G4double mean = fYield*edep*fProbability[ivox];
+  if ( mean <= 0. ) return;
+  G4long nDetected = G4Poisson(mean);
+
+  const G4double* cdf = &fTimeCdf[ivox*(fNtBins + 1)];
+  const G4double binWidth = fTmax/fNtBins;
+  for ( G4long i = 0; i < nDetected; ++i ) {
+    G4double tau = ( G4UniformRand() < fYieldRatio ) ? fFastTime : fSlowTime;
+    G4double tEmission = ( tau > 0. ) ? -tau*std::log(G4UniformRand()) : 0.;
+    G4double u = G4UniformRand();
+    G4int ibin = std::lower_bound(cdf, cdf + fNtBins + 1, u) - cdf;
+    ibin = std::min(ibin, fNtBins);
+    // Overflow: exponential tail with the mean excess over fTmax
+    G4double tTransport = ( ibin < fNtBins )
+      ? (ibin + G4UniformRand())*binWidth
+      : fTmax - fOverflowMean[ivox]*std::log(G4UniformRand());
+    arrivalTimes.push_back(t0 + tEmission + tTransport);
+  }
+}
+
+//....oooOO0OOooo........oooOO0OOooo........oooOO0OOooo........oooOO0OOooo......
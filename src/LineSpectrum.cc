@@ -0,0 +1,99 @@
+/// \file LineSpectrum.cc
+/// \brief Implementation of the LineSpectrum class
+
+#include "LineSpectrum.hh"
+
+#include "G4UnitsTable.hh"
+#include "Randomize.hh"
+
+#include <algorithm>
+#include <fstream>
+#include <sstream>
+
+//....oooOO0OOooo........oooOO0OOooo........oooOO0OOooo........oooOO0OOooo......
+
+LineSpectrum::LineSpectrum()
+{}
+
+//....oooOO0OOooo........oooOO0OOooo........oooOO0OOooo........oooOO0OOooo......
+
+LineSpectrum::~LineSpectrum()
+{}
+
+//....oooOO0OOooo........oooOO0OOooo........oooOO0OOooo........oooOO0OOooo......
+
+G4bool LineSpectrum::Load(const G4String& fileName)
+{
+  fTitle.clear();
+  fEnergies.clear();
+  fIntensities.clear();
+  std::ifstream in(fileName);
+  if ( ! in ) return false;
+
+  std::string line;
+  G4double unit = 0.;
+  while ( std::getline(in, line) ) {
+    if ( line.empty() || line[0] == '#' ) continue;
+    if ( fTitle.empty() ) { fTitle = line; continue; }
+    std::istringstream is(line);
+    if ( unit == 0. ) {
+      G4String unitName;
+      is >> unitName;
+      unit = G4UnitDefinition::GetValueOf(unitName);
+      if ( unit <= 0. ) return false;
+      continue;
+    }
+    G4double energy, intensity;
+    if ( is >> energy >> intensity && intensity > 0. ) {
+      fEnergies.push_back(energy*unit);
+      fIntensities.push_back(intensity);
+    }
+  }
+  if ( fEnergies.empty() ) return false;
+  BuildAliasTable();
+  return true;
+}
+
+//....oooOO0OOooo........oooOO0OOooo........oooOO0OOooo........oooOO0OOooo......
+
+void LineSpectrum::BuildAliasTable()
+{
+  // Vose's construction: scaled probabilities below 1 are topped up by a
+  // line above 1, which then loses the same amount
+  std::size_t n = fEnergies.size();
+  G4double total = 0.;
+  for ( auto intensity : fIntensities ) total += intensity;
+
+  fKeep.assign(n, 1.);
+  fAlias.resize(n);
+  std::vector<G4double> scaled(n);
+  std::vector<std::size_t> small, large;
+  for ( std::size_t i = 0; i < n; ++i ) {
+    fAlias[i] = i;
+    scaled[i] = fIntensities[i]*n/total;
+    ( scaled[i] < 1. ? small : large ).push_back(i);
+  }
+  while ( ! small.empty() && ! large.empty() ) {
+    std::size_t s = small.back(); small.pop_back();
+    std::size_t l = large.back();
+    fKeep[s] = scaled[s];
+    fAlias[s] = l;
+    scaled[l] -= 1. - scaled[s];
+    if ( scaled[l] < 1. ) {
+      large.pop_back();
+      small.push_back(l);
+    }
+  }
+  // Whatever is left has probability 1 up to rounding
+}
+
+//....oooOO0OOooo........oooOO0OOooo........oooOO0OOooo........oooOO0OOooo......
+
+G4double LineSpectrum::Sample() const
+{
+  G4double u = G4UniformRand()*fEnergies.size();
+  std::size_t i = std::min(static_cast<std::size_t>(u), fEnergies.size() - 1);
+  return ( u - i < fKeep[i] ) ? fEnergies[i] : fEnergies[fAlias[i]];
+}
+
+//....oooOO0OOooo........oooOO0OOooo........oooOO0OOooo........oooOO0OOooo......
@@ -0,0 +1,600 @@
+/// \file OpticalBoxModel.cc
+/// \brief Implementation of the OpticalBoxModel class
+
+#include "OpticalBoxModel.hh"
+#include "DetectorConstruction.hh"
+#include "Simd.hh"
+
+#include "G4Box.hh"
+#include "G4VSolid.hh"
+#include "G4LogicalVolume.hh"
+#include "G4VPhysicalVolume.hh"
+#include "G4Material.hh"
+#include "G4MaterialPropertiesTable.hh"
+#include "G4LogicalBorderSurface.hh"
+#include "G4LogicalSkinSurface.hh"
+#include "G4OpticalSurface.hh"
+#include "G4OpticalPhoton.hh"
+#include "G4TransportationManager.hh"
+#include "G4Navigator.hh"
+#include "G4EventManager.hh"
+#include "G4DynamicParticle.hh"
+#include "G4Track.hh"
+#include "G4TrackVector.hh"
+#include "G4FastTrack.hh"
+#include "G4FastStep.hh"
+#include "G4GeometryTolerance.hh"
+#include "G4PhysicalConstants.hh"
+#include "G4SystemOfUnits.hh"
+#include "Randomize.hh"
+
+#include <algorithm>
+#include <cfloat>
+#include <cmath>
+#include <cstdlib>
+
+namespace {
+  // Distance along (u,v,w) from (x,y,z) to the nearest wall of the box
+  // |x|,|y|,|z| <= h, and that wall coded as +-(axis + 1). Free of
+  // branches and aliasing, and marked for vectorization.
+  void DistanceToWall(std::size_t n, const G4double* h,
+                      const G4double* __restrict__ x,
+                      const G4double* __restrict__ y,
+                      const G4double* __restrict__ z,
+                      const G4double* __restrict__ u,
+                      const G4double* __restrict__ v,
+                      const G4double* __restrict__ w,
+                      G4double* __restrict__ step,
+                      G4int* __restrict__ wall)
+  {
+    const G4double hx = h[0], hy = h[1], hz = h[2];
+    TOYMC_SIMD
+    for ( std::size_t i = 0; i < n; ++i ) {
+      G4double sx = ( u[i] != 0. ) ? ( std::copysign(hx, u[i]) - x[i] )/u[i] : DBL_MAX;
+      G4double sy = ( v[i] != 0. ) ? ( std::copysign(hy, v[i]) - y[i] )/v[i] : DBL_MAX;
+      G4double sz = ( w[i] != 0. ) ? ( std::copysign(hz, w[i]) - z[i] )/w[i] : DBL_MAX;
+      G4double s = sx;
+      G4int k = ( u[i] > 0. ) ? 1 : -1;
+      G4bool yCloser = ( sy < s );
+      s = yCloser ? sy : s;
+      k = yCloser ? ( ( v[i] > 0. ) ? 2 : -2 ) : k;
+      G4bool zCloser = ( sz < s );
+      s = zCloser ? sz : s;
+      k = zCloser ? ( ( w[i] > 0. ) ? 3 : -3 ) : k;
+      step[i] = std::max(s, 0.);
+      wall[i] = k;
+    }
+  }
+
+  // Move the photons to the wall, or to the absorption point if closer
+  void Advance(std::size_t n,
+               const G4double* __restrict__ wallStep,
+               const G4double* __restrict__ absStep,
+               const G4double* __restrict__ invSpeed,
+               const G4double* __restrict__ u,
+               const G4double* __restrict__ v,
+               const G4double* __restrict__ w,
+               G4double* __restrict__ x,
+               G4double* __restrict__ y,
+               G4double* __restrict__ z,
+               G4double* __restrict__ time)
+  {
+    TOYMC_SIMD
+    for ( std::size_t i = 0; i < n; ++i ) {
+      G4double s = std::min(wallStep[i], absStep[i]);
+      x[i] += s*u[i];
+      y[i] += s*v[i];
+      z[i] += s*w[i];
+      time[i] += s*invSpeed[i];
+    }
+  }
+
+  // Handed-back photons start this far outside the wall
+  const G4double kNudge = 1.*nanometer;
+  // Photons trapped by total internal reflection are dropped after
+  // this many passes
+  const G4int kMaxPasses = 100000;
+}
+
+//....oooOO0OOooo........oooOO0OOooo........oooOO0OOooo........oooOO0OOooo......
+
+G4ThreadLocal OpticalBoxModel* OpticalBoxModel::fInstance = 0;
+
+//....oooOO0OOooo........oooOO0OOooo........oooOO0OOooo........oooOO0OOooo......
+
+void OpticalBoxModel::PhotonBatch::Resize(std::size_t n)
+{
+  for ( auto array : { &x, &y, &z, &u, &v, &w, &px, &py, &pz, &time, &energy,
+                       &weight, &invSpeed, &rindex, &absLength, &reflectivity,
+                       &transmittance, &outsideRindex, &absStep, &wallStep,
+                       &surfaceRand, &fresnelRand, &wallReflectivity,
+                       &wallTransmittance, &wallRindex } ) {
+    array->resize(n);
+  }
+  parentID.resize(n);
+  wall.resize(n);
+  fate.resize(n);
+}
+
+//....oooOO0OOooo........oooOO0OOooo........oooOO0OOooo........oooOO0OOooo......
+
+void OpticalBoxModel::PhotonBatch::Move(std::size_t from, std::size_t to)
+{
+  if ( from == to ) return;
+  for ( auto array : { &x, &y, &z, &u, &v, &w, &px, &py, &pz, &time, &energy,
+                       &weight, &invSpeed, &rindex, &absLength, &reflectivity,
+                       &transmittance, &outsideRindex } ) {
+    (*array)[to] = (*array)[from];
+  }
+  parentID[to] = parentID[from];
+}
+
+//....oooOO0OOooo........oooOO0OOooo........oooOO0OOooo........oooOO0OOooo......
+
+OpticalBoxModel::OpticalBoxModel(G4Region* envelope, G4LogicalVolume* box,
+                                 const DetectorConstruction* detector)
+ : G4VFastSimulationModel("OpticalBoxModel", envelope),
+   fBox(box),
+   fDetector(detector),
+   fOpticalPhoton(G4OpticalPhoton::OpticalPhotonDefinition()),
+   fSupported(false),
+   fWarned(false),
+   fRindex(0),
+   fGroupVelocity(0),
+   fAbsLength(0),
+   fReflectivity(0),
+   fTransmittance(0),
+   fOutsideRindex(0)
+{
+  fHalf[0] = fHalf[1] = fHalf[2] = 0.;
+  fInstance = this;
+}
+
+//....oooOO0OOooo........oooOO0OOooo........oooOO0OOooo........oooOO0OOooo......
+
+OpticalBoxModel::~OpticalBoxModel()
+{
+  if ( fInstance == this ) fInstance = 0;
+}
+
+//....oooOO0OOooo........oooOO0OOooo........oooOO0OOooo........oooOO0OOooo......
+
+G4bool OpticalBoxModel::IsApplicable(const G4ParticleDefinition& particle)
+{
+  return &particle == fOpticalPhoton;
+}
+
+//....oooOO0OOooo........oooOO0OOooo........oooOO0OOooo........oooOO0OOooo......
+
+G4bool OpticalBoxModel::ModelTrigger(const G4FastTrack& fastTrack)
+{
+  // The region also holds the Detector
+  if ( ! fDetector->GetFastOptics()
+       || fastTrack.GetEnvelopeLogicalVolume() != fBox ) return false;
+  // Geometry and materials can only change between events
+  if ( fBatch.Size() == 0 ) fSupported = Setup(fastTrack);
+  return fSupported;
+}
+
+//....oooOO0OOooo........oooOO0OOooo........oooOO0OOooo........oooOO0OOooo......
+
+void OpticalBoxModel::Warn(const G4String& reason)
+{
+  if ( fWarned ) return;
+  fWarned = true;
+  G4ExceptionDescription ed;
+  ed << "Fast optical transport disabled: " << reason
+     << ". Optical photons are tracked by Geant4.";
+  G4Exception("OpticalBoxModel::Setup()", "toyMC_fast001", JustWarning, ed);
+}
+
+//....oooOO0OOooo........oooOO0OOooo........oooOO0OOooo........oooOO0OOooo......
+
+G4bool OpticalBoxModel::Setup(const G4FastTrack& fastTrack)
+{
+  auto box = dynamic_cast<const G4Box*>(fBox->GetSolid());
+  if ( ! box ) {
+    Warn("the scintillator is not a G4Box");
+    return false;
+  }
+  if ( fBox->GetNoDaughters() > 0 ) {
+    Warn("the scintillator has daughter volumes");
+    return false;
+  }
+  fHalf[0] = box->GetXHalfLength();
+  fHalf[1] = box->GetYHalfLength();
+  fHalf[2] = box->GetZHalfLength();
+  fToGlobal = *fastTrack.GetInverseAffineTransformation();
+
+  // Bulk: absorption only
+  G4MaterialPropertiesTable* mpt
+    = fBox->GetMaterial()->GetMaterialPropertiesTable();
+  fRindex = mpt ? mpt->GetProperty("RINDEX") : 0;
+  if ( ! fRindex ) {
+    Warn("the scintillator has no RINDEX");
+    return false;
+  }
+  if ( mpt->GetProperty("RAYLEIGH") || mpt->GetProperty("MIEHG")
+       || mpt->GetProperty("WLSABSLENGTH") ) {
+    Warn("only absorption is modelled in the scintillator bulk");
+    return false;
+  }
+  fAbsLength = mpt->GetProperty("ABSLENGTH");
+  fGroupVelocity = mpt->GetProperty("GROUPVEL");
+
+  // Outside: the world
+  const G4VPhysicalVolume* boxVolume = fastTrack.GetEnvelopePhysicalVolume();
+  G4VPhysicalVolume* world = G4TransportationManager::GetTransportationManager()
+    ->GetNavigatorForTracking()->GetWorldVolume();
+  if ( boxVolume->GetMotherLogical() != world->GetLogicalVolume()
+       || world->GetLogicalVolume()->GetMaterial() == fBox->GetMaterial() ) {
+    Warn("the scintillator must sit in a world of another material");
+    return false;
+  }
+  G4MaterialPropertiesTable* outside
+    = world->GetLogicalVolume()->GetMaterial()->GetMaterialPropertiesTable();
+  fOutsideRindex = outside ? outside->GetProperty("RINDEX") : 0;
+  if ( ! FindSurface(boxVolume, world, fReflectivity, fTransmittance) ) {
+    return false;
+  }
+
+  // Other world daughters whose bounding box touches the box; the patch
+  // of wall they actually cover is found photon by photon
+  static const G4double tolerance
+    = G4GeometryTolerance::GetInstance()->GetSurfaceTolerance();
+  const G4AffineTransform toBox = fToGlobal.Inverse();
+  G4LogicalVolume* worldLogical = world->GetLogicalVolume();
+  fContacts.clear();
+  for ( std::size_t k = 0; k < worldLogical->GetNoDaughters(); ++k ) {
+    G4VPhysicalVolume* daughter = worldLogical->GetDaughter(k);
+    if ( daughter == boxVolume ) continue;
+    G4LogicalVolume* logical = daughter->GetLogicalVolume();
+    const G4AffineTransform toWorld(daughter->GetRotation(),
+                                    daughter->GetTranslation());
+    G4ThreeVector pMin, pMax;
+    logical->GetSolid()->BoundingLimits(pMin, pMax);
+    G4ThreeVector lo(DBL_MAX, DBL_MAX, DBL_MAX);
+    G4ThreeVector hi(-DBL_MAX, -DBL_MAX, -DBL_MAX);
+    for ( G4int corner = 0; corner < 8; ++corner ) {
+      G4ThreeVector p((corner & 1) ? pMax.x() : pMin.x(),
+                      (corner & 2) ? pMax.y() : pMin.y(),
+                      (corner & 4) ? pMax.z() : pMin.z());
+      p = toBox.TransformPoint(toWorld.TransformPoint(p));
+      for ( G4int a = 0; a < 3; ++a ) {
+        lo[a] = std::min(lo[a], p[a]);
+        hi[a] = std::max(hi[a], p[a]);
+      }
+    }
+    G4bool apart = false;
+    for ( G4int a = 0; a < 3; ++a ) {
+      apart = apart || lo[a] > fHalf[a] + tolerance
+                    || hi[a] < -fHalf[a] - tolerance;
+    }
+    if ( apart ) continue;
+
+    if ( logical->GetSensitiveDetector() ) {
+      Warn("the sensitive volume " + daughter->GetName()
+           + " touches the scintillator");
+      return false;
+    }
+    if ( logical->GetNoDaughters() > 0 ) {
+      Warn("the volume " + daughter->GetName()
+           + " touches the scintillator and has daughter volumes");
+      return false;
+    }
+    Contact contact;
+    contact.solid = logical->GetSolid();
+    contact.toLocal = fToGlobal*toWorld.Inverse();
+    G4MaterialPropertiesTable* contactMpt
+      = logical->GetMaterial()->GetMaterialPropertiesTable();
+    contact.rindex = contactMpt ? contactMpt->GetProperty("RINDEX") : 0;
+    if ( ! FindSurface(boxVolume, daughter, contact.reflectivity,
+                       contact.transmittance) ) return false;
+    fContacts.push_back(contact);
+  }
+  return true;
+}
+
+//....oooOO0OOooo........oooOO0OOooo........oooOO0OOooo........oooOO0OOooo......
+
+G4bool OpticalBoxModel::FindSurface(const G4VPhysicalVolume* boxVolume,
+                                    const G4VPhysicalVolume* outside,
+                                    G4MaterialPropertyVector*& reflectivity,
+                                    G4MaterialPropertyVector*& transmittance)
+{
+  // Border surface, else skin surface of the box, else of the volume
+  // outside: none (perfectly polished, reflectivity 1) or polished
+  // dielectric_dielectric
+  G4LogicalSurface* logicalSurface
+    = G4LogicalBorderSurface::GetSurface(boxVolume, outside);
+  if ( ! logicalSurface ) logicalSurface = G4LogicalSkinSurface::GetSurface(fBox);
+  if ( ! logicalSurface ) {
+    logicalSurface = G4LogicalSkinSurface::GetSurface(outside->GetLogicalVolume());
+  }
+  const G4OpticalSurface* surface = logicalSurface
+    ? dynamic_cast<const G4OpticalSurface*>(logicalSurface->GetSurfaceProperty())
+    : 0;
+  reflectivity = transmittance = 0;
+  if ( logicalSurface ) {
+    if ( ! surface || surface->GetType() != dielectric_dielectric
+         || surface->GetFinish() != polished ) {
+      Warn("only polished dielectric_dielectric surfaces are modelled");
+      return false;
+    }
+    G4MaterialPropertiesTable* smpt = surface->GetMaterialPropertiesTable();
+    if ( smpt ) {
+      reflectivity = smpt->GetProperty("REFLECTIVITY");
+      transmittance = smpt->GetProperty("TRANSMITTANCE");
+    }
+  }
+  return true;
+}
+
+//....oooOO0OOooo........oooOO0OOooo........oooOO0OOooo........oooOO0OOooo......
+
+void OpticalBoxModel::DoIt(const G4FastTrack& fastTrack, G4FastStep& fastStep)
+{
+  const G4Track* track = fastTrack.GetPrimaryTrack();
+  G4ThreeVector position = fastTrack.GetPrimaryTrackLocalPosition();
+  G4ThreeVector direction = fastTrack.GetPrimaryTrackLocalDirection();
+  G4ThreeVector polarization = fastTrack.GetPrimaryTrackLocalPolarization();
+  G4double energy = track->GetKineticEnergy();
+
+  PhotonBatch& b = fBatch;
+  std::size_t i = b.Size();
+  b.Resize(i + 1);
+  b.x[i] = position.x();
+  b.y[i] = position.y();
+  b.z[i] = position.z();
+  b.u[i] = direction.x();
+  b.v[i] = direction.y();
+  b.w[i] = direction.z();
+  b.px[i] = polarization.x();
+  b.py[i] = polarization.y();
+  b.pz[i] = polarization.z();
+  b.time[i] = track->GetGlobalTime();
+  b.energy[i] = energy;
+  b.weight[i] = track->GetWeight();
+  b.parentID[i] = track->GetTrackID();
+  b.rindex[i] = fRindex->Value(energy);
+  b.invSpeed[i] = fGroupVelocity ? 1./fGroupVelocity->Value(energy)
+                                 : b.rindex[i]/c_light;
+  b.absLength[i] = fAbsLength ? fAbsLength->Value(energy) : DBL_MAX;
+  b.reflectivity[i] = fReflectivity ? fReflectivity->Value(energy) : 1.;
+  b.transmittance[i] = fTransmittance ? fTransmittance->Value(energy) : 0.;
+  b.outsideRindex[i] = fOutsideRindex ? fOutsideRindex->Value(energy) : -1.;
+
+  fastStep.KillPrimaryTrack();
+  fastStep.ProposePrimaryTrackPathLength(0.);
+
+  if ( b.Size() >= std::size_t(fDetector->GetFastBatchSize()) ) TraceBatch();
+}
+
+//....oooOO0OOooo........oooOO0OOooo........oooOO0OOooo........oooOO0OOooo......
+
+void OpticalBoxModel::TraceBatch()
+{
+  PhotonBatch& b = fBatch;
+  std::size_t n = b.Size();
+  if ( n == 0 ) return;
+
+  G4TrackVector leaving;
+  for ( G4int pass = 0; n > 0 && pass < kMaxPasses; ++pass ) {
+    for ( std::size_t i = 0; i < n; ++i ) {
+      b.absStep[i] = -b.absLength[i]*std::log(G4UniformRand());
+      b.surfaceRand[i] = G4UniformRand();
+      b.fresnelRand[i] = G4UniformRand();
+    }
+    DistanceToWall(n, fHalf, b.x.data(), b.y.data(), b.z.data(),
+                   b.u.data(), b.v.data(), b.w.data(),
+                   b.wallStep.data(), b.wall.data());
+    Advance(n, b.wallStep.data(), b.absStep.data(), b.invSpeed.data(),
+            b.u.data(), b.v.data(), b.w.data(),
+            b.x.data(), b.y.data(), b.z.data(), b.time.data());
+
+    if ( ! fContacts.empty() ) ContactPatches(n);
+    Boundary(n);
+
+    // The photons still inside are compacted
+    std::size_t inside = 0;
+    for ( std::size_t i = 0; i < n; ++i ) {
+      if ( b.absStep[i] < b.wallStep[i] ) continue;   // absorbed in the bulk
+      if ( b.fate[i] == kLeaving ) leaving.push_back(MakeTrack(i));
+      else if ( b.fate[i] == kInside ) b.Move(i, inside++);
+    }
+    n = inside;
+  }
+  b.Resize(0);
+
+  if ( ! leaving.empty() ) {
+    G4EventManager::GetEventManager()->StackTracks(&leaving);
+  }
+}
+
+//....oooOO0OOooo........oooOO0OOooo........oooOO0OOooo........oooOO0OOooo......
+
+void OpticalBoxModel::ContactPatches(std::size_t n)
+{
+  // Where a neighbour covers the wall, its material and surface replace
+  // those of the world. The point tested is just outside the wall.
+  PhotonBatch& b = fBatch;
+  for ( std::size_t i = 0; i < n; ++i ) {
+    b.wallReflectivity[i] = b.reflectivity[i];
+    b.wallTransmittance[i] = b.transmittance[i];
+    b.wallRindex[i] = b.outsideRindex[i];
+    if ( b.absStep[i] < b.wallStep[i] ) continue;
+
+    G4ThreeVector point(b.x[i], b.y[i], b.z[i]);
+    const G4int axis = std::abs(b.wall[i]) - 1;
+    point[axis] += ( b.wall[i] > 0 ) ? kNudge : -kNudge;
+    for ( const auto& contact : fContacts ) {
+      if ( contact.solid->Inside(contact.toLocal.TransformPoint(point))
+           == kOutside ) continue;
+      const G4double energy = b.energy[i];
+      b.wallReflectivity[i]
+        = contact.reflectivity ? contact.reflectivity->Value(energy) : 1.;
+      b.wallTransmittance[i]
+        = contact.transmittance ? contact.transmittance->Value(energy) : 0.;
+      b.wallRindex[i] = contact.rindex ? contact.rindex->Value(energy) : -1.;
+      break;
+    }
+  }
+}
+
+//....oooOO0OOooo........oooOO0OOooo........oooOO0OOooo........oooOO0OOooo......
+
+void OpticalBoxModel::Boundary(std::size_t n)
+{
+  // The steps of G4OpBoundaryProcess for a polished dielectric_dielectric
+  // surface, for all photons at once: every outcome is computed and the
+  // one that applies is selected, so that the loop has no branches
+  static const G4double tolerance
+    = G4GeometryTolerance::GetInstance()->GetSurfaceTolerance();
+  PhotonBatch& b = fBatch;
+  G4double* u = b.u.data();
+  G4double* v = b.v.data();
+  G4double* w = b.w.data();
+  G4double* px = b.px.data();
+  G4double* py = b.py.data();
+  G4double* pz = b.pz.data();
+  G4double* fate = b.fate.data();
+  const G4int* wall = b.wall.data();
+  const G4double* rindex = b.rindex.data();
+  const G4bool contacts = ! fContacts.empty();
+  const G4double* outsideRindex
+    = contacts ? b.wallRindex.data() : b.outsideRindex.data();
+  const G4double* reflectivity
+    = contacts ? b.wallReflectivity.data() : b.reflectivity.data();
+  const G4double* transmittance
+    = contacts ? b.wallTransmittance.data() : b.transmittance.data();
+  const G4double* surfaceRand = b.surfaceRand.data();
+  const G4double* fresnelRand = b.fresnelRand.data();
+
+  TOYMC_SIMD
+  for ( std::size_t i = 0; i < n; ++i ) {
+    // Normal of the wall, pointing back into the box
+    const G4int axis = ( wall[i] < 0 ) ? -wall[i] : wall[i];
+    const G4double sign = ( wall[i] > 0 ) ? -1. : 1.;
+    const G4double nx = ( axis == 1 ) ? sign : 0.;
+    const G4double ny = ( axis == 2 ) ? sign : 0.;
+    const G4double nz = ( axis == 3 ) ? sign : 0.;
+    const G4double mx = u[i], my = v[i], mz = w[i];
+    const G4double ex = px[i], ey = py[i], ez = pz[i];
+
+    // Surface: NoRINDEX outside, absorption, transmission as is
+    const G4double n1 = rindex[i];
+    const G4bool noRindex = ( outsideRindex[i] < 0. );
+    const G4double n2 = noRindex ? 1. : outsideRindex[i];
+    const G4double R = reflectivity[i];
+    const G4double T = transmittance[i];
+    const G4bool killed = noRindex | ( surfaceRand[i] > R + T );
+    const G4bool transmitted = ! killed & ( surfaceRand[i] > R );
+
+    // Fresnel
+    const G4double mn = mx*nx + my*ny + mz*nz;
+    const G4double cost1 = -mn;
+    const G4bool oblique = ( cost1 < 1. - tolerance );
+    const G4double sint1 = oblique ? std::sqrt(std::max(1. - cost1*cost1, 0.)) : 0.;
+    const G4double sint2 = sint1*n1/n2;
+    const G4bool tir = ( sint2 >= 1. );
+    const G4double cost2 = std::sqrt(std::max(1. - sint2*sint2, 0.));
+
+    // s-polarization direction (momentum x normal) and the components
+    const G4double cx = my*nz - mz*ny;
+    const G4double cy = mz*nx - mx*nz;
+    const G4double cz = mx*ny - my*nx;
+    const G4double cinv = 1./std::sqrt(cx*cx + cy*cy + cz*cz);
+    const G4double tx = oblique ? cx*cinv : ex;
+    const G4double ty = oblique ? cy*cinv : ey;
+    const G4double tz = oblique ? cz*cinv : ez;
+    const G4double e1Perp = oblique ? ex*tx + ey*ty + ez*tz : 0.;
+    const G4double qx = ex - e1Perp*tx, qy = ey - e1Perp*ty, qz = ez - e1Perp*tz;
+    const G4double e1Parl = oblique ? std::sqrt(qx*qx + qy*qy + qz*qz) : 1.;
+    const G4double s1 = n1*cost1;
+    const G4double e2Perp = 2.*s1*e1Perp/(n1*cost1 + n2*cost2);
+    const G4double e2Parl = 2.*s1*e1Parl/(n2*cost1 + n1*cost2);
+    const G4double e2Total = e2Perp*e2Perp + e2Parl*e2Parl;
+    const G4double transCoeff = ( T > 0. ) ? T : n2*cost2*e2Total/s1;
+    const G4bool refracted = ! tir & ( fresnelRand[i] < transCoeff );
+
+    // New momentum: mirrored, or refracted out of the box
+    const G4double alpha = cost1 - cost2*n2/n1;
+    const G4double fx = mx + alpha*nx, fy = my + alpha*ny, fz = mz + alpha*nz;
+    const G4double finv = 1./std::sqrt(fx*fx + fy*fy + fz*fz);
+    const G4double ox = refracted ? fx*finv : mx - 2.*mn*nx;
+    const G4double oy = refracted ? fy*finv : my - 2.*mn*ny;
+    const G4double oz = refracted ? fz*finv : mz - 2.*mn*nz;
+
+    // New polarization. Total internal reflection mirrors it; Fresnel
+    // reflection and refraction combine the s and p amplitudes along the
+    // s direction and new momentum x s direction
+    const G4double en = ex*nx + ey*ny + ez*nz;
+    const G4double rPerp = e2Perp - e1Perp;
+    const G4double rParl = n2*e2Parl/n1 - e1Parl;
+    const G4double cPerp = refracted ? e2Perp : rPerp;
+    const G4double cParl = refracted ? e2Parl : rParl;
+    const G4double cinv2 = 1./std::sqrt(cPerp*cPerp + cParl*cParl);
+    const G4double ax = oy*tz - oz*ty;
+    const G4double ay = oz*tx - ox*tz;
+    const G4double az = ox*ty - oy*tx;
+    const G4double ainv = 1./std::sqrt(ax*ax + ay*ay + az*az);
+    const G4double obliqueX = cParl*cinv2*ax*ainv + cPerp*cinv2*tx;
+    const G4double obliqueY = cParl*cinv2*ay*ainv + cPerp*cinv2*ty;
+    const G4double obliqueZ = cParl*cinv2*az*ainv + cPerp*cinv2*tz;
+    // at normal incidence: unchanged, or reversed when reflected on a
+    // denser medium
+    const G4double flip = ( ! refracted & ( n2 > n1 ) ) ? -1. : 1.;
+    G4double ox2 = oblique ? obliqueX : flip*ex;
+    G4double oy2 = oblique ? obliqueY : flip*ey;
+    G4double oz2 = oblique ? obliqueZ : flip*ez;
+    ox2 = tir ? -ex + 2.*en*nx : ox2;
+    oy2 = tir ? -ey + 2.*en*ny : oy2;
+    oz2 = tir ? -ez + 2.*en*nz : oz2;
+
+    // Transmitted as is: nothing changes. Blended rather than selected,
+    // a select of the loaded value turns into a conditional store
+    const G4double keep = transmitted ? 0. : 1.;
+    u[i] = mx + keep*( ox - mx );
+    v[i] = my + keep*( oy - my );
+    w[i] = mz + keep*( oz - mz );
+    px[i] = ex + keep*( ox2 - ex );
+    py[i] = ey + keep*( oy2 - ey );
+    pz[i] = ez + keep*( oz2 - ez );
+    const G4double leaves = ( transmitted | refracted ) ? kLeaving : kInside;
+    fate[i] = killed ? kKilled : leaves;
+  }
+}
+
+//....oooOO0OOooo........oooOO0OOooo........oooOO0OOooo........oooOO0OOooo......
+
+G4Track* OpticalBoxModel::MakeTrack(std::size_t i) const
+{
+  const PhotonBatch& b = fBatch;
+  G4ThreeVector direction
+    = fToGlobal.TransformAxis(G4ThreeVector(b.u[i], b.v[i], b.w[i]));
+  G4ThreeVector polarization
+    = fToGlobal.TransformAxis(G4ThreeVector(b.px[i], b.py[i], b.pz[i]));
+  // Just outside the wall, so that the track starts in the world or in the
+  // volume touching the box there
+  G4ThreeVector position
+    = fToGlobal.TransformPoint(G4ThreeVector(b.x[i], b.y[i], b.z[i]))
+      + kNudge*direction;
+
+  auto particle = new G4DynamicParticle(fOpticalPhoton, direction, b.energy[i]);
+  particle->SetPolarization(polarization.x(), polarization.y(), polarization.z());
+  auto track = new G4Track(particle, b.time[i], position);
+  track->SetParentID(b.parentID[i]);
+  track->SetWeight(b.weight[i]);
+  track->SetUserInformation(new HandedBack);
+  return track;
+}
+
+//....oooOO0OOooo........oooOO0OOooo........oooOO0OOooo........oooOO0OOooo......
+
+G4bool OpticalBoxModel::IsHandedBack(const G4Track* track)
+{
+  const G4VUserTrackInformation* info = track->GetUserInformation();
+  return info && dynamic_cast<const HandedBack*>(info);
+}
+
+//....oooOO0OOooo........oooOO0OOooo........oooOO0OOooo........oooOO0OOooo......
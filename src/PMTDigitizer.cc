@@ -0,0 +1,159 @@
+/// \file PMTDigitizer.cc
+/// \brief Implementation of the PMTDigitizer class
+
+#include "PMTDigitizer.hh"
+#include "Simd.hh"
+
+#include "G4GenericMessenger.hh"
+#include "G4SystemOfUnits.hh"
+#include "Randomize.hh"
+
+#include <algorithm>
+#include <cmath>
+
+namespace {
+  // y[0..n) += a*x[0..n); free of aliasing and marked for vectorization
+  void Axpy(std::size_t n, float a, const float* __restrict__ x,
+            float* __restrict__ y)
+  {
+    TOYMC_SIMD
+    for ( std::size_t k = 0; k < n; ++k ) y[k] += a*x[k];
+  }
+}
+
+//....oooOO0OOooo........oooOO0OOooo........oooOO0OOooo........oooOO0OOooo......
+
+PMTDigitizer::PMTDigitizer()
+ : fEnabled(false),
+   fKeepWaveform(false),
+   fBinWidth(0.5*ns),
+   fWindow(400.*ns),
+   fRiseTime(1.*ns),
+   fFallTime(4.*ns),
+   fGainSigma(0.3),
+   fPreGate(10.*ns),
+   fTailStart(20.*ns),
+   fGate(200.*ns),
+   fMessenger(0),
+   fBuiltBinWidth(0.), fBuiltRise(0.), fBuiltFall(0.), fBuiltWindow(0.),
+   fQTotal(0.),
+   fQTail(0.)
+{
+  fMessenger = new G4GenericMessenger(this, "/toy/digi/", "PMT digitization");
+  fMessenger->DeclareProperty("enable", fEnabled,
+    "Compute the PMT waveform and its qTotal/qTail charges per event");
+  fMessenger->DeclareProperty("waveform", fKeepWaveform,
+    "Also write the sampled waveform to the event ntuple");
+  fMessenger->DeclarePropertyWithUnit("binWidth", "ns", fBinWidth,
+    "Sampling interval of the waveform").SetRange("binWidth>0.");
+  fMessenger->DeclarePropertyWithUnit("window", "ns", fWindow,
+    "Length of the waveform, from the event time 0").SetRange("window>0.");
+  fMessenger->DeclarePropertyWithUnit("speRise", "ns", fRiseTime,
+    "Rise time constant of the single photoelectron response")
+    .SetRange("speRise>0.");
+  fMessenger->DeclarePropertyWithUnit("speFall", "ns", fFallTime,
+    "Fall time constant of the single photoelectron response")
+    .SetRange("speFall>0.");
+  fMessenger->DeclareProperty("gainSigma", fGainSigma,
+    "Relative width of the single photoelectron charge")
+    .SetRange("gainSigma>=0.");
+  fMessenger->DeclarePropertyWithUnit("preGate", "ns", fPreGate,
+    "Start of the integration before the peak");
+  fMessenger->DeclarePropertyWithUnit("tailStart", "ns", fTailStart,
+    "Start of the tail integration after the peak");
+  fMessenger->DeclarePropertyWithUnit("gate", "ns", fGate,
+    "End of the integrations after the peak");
+}
+
+//....oooOO0OOooo........oooOO0OOooo........oooOO0OOooo........oooOO0OOooo......
+
+PMTDigitizer::~PMTDigitizer()
+{
+  delete fMessenger;
+}
+
+//....oooOO0OOooo........oooOO0OOooo........oooOO0OOooo........oooOO0OOooo......
+
+void PMTDigitizer::BuildResponse()
+{
+  // Sampled up to 10 fall times, normalized to unit area
+  std::size_t nResponse
+    = std::max<std::size_t>(1, std::ceil(10.*fFallTime/fBinWidth));
+  fResponse.resize(nResponse);
+  G4double sum = 0.;
+  for ( std::size_t k = 0; k < nResponse; ++k ) {
+    G4double t = ( k + 0.5 )*fBinWidth;
+    G4double value = std::exp(-t/fFallTime)
+      - ( fRiseTime != fFallTime ? std::exp(-t/fRiseTime) : 0. );
+    fResponse[k] = value;
+    sum += value;
+  }
+  for ( auto& value : fResponse ) value /= sum;
+
+  std::size_t nBins = std::ceil(fWindow/fBinWidth);
+  fCharge.assign(nBins, 0.);
+  fSignal.assign(nBins + nResponse, 0.);
+
+  fBuiltBinWidth = fBinWidth;
+  fBuiltRise = fRiseTime;
+  fBuiltFall = fFallTime;
+  fBuiltWindow = fWindow;
+}
+
+//....oooOO0OOooo........oooOO0OOooo........oooOO0OOooo........oooOO0OOooo......
+
+void PMTDigitizer::Digitize(const std::vector<G4double>& photonTimes)
+{
+  if ( fBinWidth != fBuiltBinWidth || fRiseTime != fBuiltRise
+       || fFallTime != fBuiltFall || fWindow != fBuiltWindow ) {
+    BuildResponse();
+  }
+  std::size_t nBins = fCharge.size();
+  std::fill(fCharge.begin(), fCharge.end(), 0.f);
+  std::fill(fSignal.begin(), fSignal.end(), 0.f);
+  fWaveform.clear();
+  fQTotal = fQTail = 0.;
+
+  // Photoelectron charges per time bin
+  for ( auto t : photonTimes ) {
+    if ( t < 0. || t >= fWindow ) continue;
+    G4double charge = 1.;
+    if ( fGainSigma > 0. ) {
+      charge = std::max(0., G4RandGauss::shoot(1., fGainSigma));
+    }
+    fCharge[static_cast<std::size_t>(t/fBinWidth)] += charge;
+  }
+
+  // Convolution: one scaled response per non-empty bin
+  std::size_t nResponse = fResponse.size();
+  const float* response = fResponse.data();
+  float* signal = fSignal.data();
+  std::size_t peak = 0;
+  G4bool empty = true;
+  for ( std::size_t i = 0; i < nBins; ++i ) {
+    if ( fCharge[i] == 0.f ) continue;
+    Axpy(nResponse, fCharge[i], response, signal + i);
+    empty = false;
+  }
+  if ( empty ) return;
+  for ( std::size_t i = 1; i < nBins; ++i ) {
+    if ( signal[i] > signal[peak] ) peak = i;
+  }
+
+  // Integrals in units of the mean photoelectron charge
+  auto bin = [this, peak, nBins](G4double offset) {
+    G4double b = peak + std::floor(offset/fBinWidth);
+    return static_cast<std::size_t>(std::min<G4double>(std::max(b, 0.), nBins));
+  };
+  std::size_t totalBegin = bin(-fPreGate);
+  std::size_t tailBegin = bin(fTailStart);
+  std::size_t end = bin(fGate);
+  for ( std::size_t i = totalBegin; i < end; ++i ) {
+    fQTotal += signal[i];
+    if ( i >= tailBegin ) fQTail += signal[i];
+  }
+
+  if ( fKeepWaveform ) fWaveform.assign(signal, signal + nBins);
+}
+
+//....oooOO0OOooo........oooOO0OOooo........oooOO0OOooo........oooOO0OOooo......
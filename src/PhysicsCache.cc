@@ -0,0 +1,183 @@
+/// \file PhysicsCache.cc
+/// \brief Implementation of the PhysicsCache class
+
+#include "PhysicsCache.hh"
+
+#include "G4StateManager.hh"
+#include "G4VUserPhysicsList.hh"
+#include "G4Material.hh"
+#include "G4Element.hh"
+#include "G4LogicalVolume.hh"
+#include "G4LogicalVolumeStore.hh"
+#include "G4Region.hh"
+#include "G4RegionStore.hh"
+#include "G4ProductionCuts.hh"
+#include "G4SystemOfUnits.hh"
+
+#include <sys/stat.h>
+#include <dirent.h>
+#include <unistd.h>
+#include <cstdio>
+#include <fstream>
+#include <functional>
+#include <iterator>
+#include <sstream>
+#include <vector>
+
+namespace {
+  const char* const kStamp = "toyMC.tables";
+}
+
+//....oooOO0OOooo........oooOO0OOooo........oooOO0OOooo........oooOO0OOooo......
+
+PhysicsCache::PhysicsCache(const G4String& directory, const G4String& physics,
+                           G4VUserPhysicsList* physicsList)
+ : G4VStateDependent(),
+   fDirectory(directory),
+   fPhysics(physics),
+   fPhysicsList(physicsList),
+   fLookedUp(false),
+   fRetrieved(false)
+{
+  mkdir(fDirectory.c_str(), 0755);
+}
+
+//....oooOO0OOooo........oooOO0OOooo........oooOO0OOooo........oooOO0OOooo......
+
+PhysicsCache::~PhysicsCache()
+{}
+
+//....oooOO0OOooo........oooOO0OOooo........oooOO0OOooo........oooOO0OOooo......
+
+G4bool PhysicsCache::Notify(G4ApplicationState requestedState)
+{
+  G4ApplicationState state = G4StateManager::GetStateManager()->GetCurrentState();
+  if ( ! fLookedUp && state == G4State_Idle && requestedState == G4State_Init ) {
+    // The first run starts: geometry, materials and cuts are final
+    fLookedUp = true;
+    G4String key = Key();
+    G4String subdirectory = Subdirectory(key);
+    G4String stored;
+    if ( ReadStamp(subdirectory, stored) && stored == key ) {
+      G4cout << "Retrieving physics tables from " << subdirectory << G4endl;
+      fPhysicsList->SetPhysicsTableRetrieved(subdirectory);
+      fRetrieved = true;
+    }
+  }
+  else if ( fRetrieved && state == G4State_Init
+            && requestedState == G4State_Idle ) {
+    // Tables rebuilt later (/run/physicsModified) are not for this key
+    fPhysicsList->ResetPhysicsTableRetrieved();
+  }
+  return true;
+}
+
+//....oooOO0OOooo........oooOO0OOooo........oooOO0OOooo........oooOO0OOooo......
+
+void PhysicsCache::Store()
+{
+  if ( ! fLookedUp || fRetrieved ) return;
+
+  G4String key = Key();
+  G4String subdirectory = Subdirectory(key);
+  G4String stored;
+  if ( ReadStamp(subdirectory, stored) ) return;
+
+  G4String pattern = fDirectory + "/.tmp-XXXXXX";
+  std::vector<char> buffer(pattern.begin(), pattern.end());
+  buffer.push_back('\0');
+  if ( ! mkdtemp(buffer.data()) ) {
+    G4cout << "Cannot create a directory in " << fDirectory
+           << ", physics tables not stored" << G4endl;
+    return;
+  }
+  G4String temporary = buffer.data();
+  G4bool stamped = false;
+  if ( fPhysicsList->StorePhysicsTable(temporary) ) {
+    std::ofstream stamp((temporary + "/" + kStamp).c_str());
+    stamp << key;
+    stamp.close();
+    stamped = ! stamp.fail();
+  }
+  if ( stamped && std::rename(temporary.c_str(), subdirectory.c_str()) == 0 ) {
+    G4cout << "Physics tables stored in " << subdirectory << G4endl;
+  }
+  else {
+    // Failed, or another job stored the same tables first
+    Remove(temporary);
+  }
+}
+
+//....oooOO0OOooo........oooOO0OOooo........oooOO0OOooo........oooOO0OOooo......
+
+G4String PhysicsCache::Key() const
+{
+  std::ostringstream key;
+  key.precision(12);
+  key << "physics " << fPhysics << "+optical+fastsim\n"
+      << "defaultCut " << fPhysicsList->GetDefaultCutValue()/mm << "\n";
+  for ( const G4Material* material : *G4Material::GetMaterialTable() ) {
+    key << "material " << material->GetName() << " "
+        << material->GetDensity()/(g/cm3);
+    const G4double* fractions = material->GetFractionVector();
+    for ( std::size_t i = 0; i < material->GetNumberOfElements(); ++i ) {
+      key << " " << material->GetElement(i)->GetName() << " " << fractions[i];
+    }
+    key << "\n";
+  }
+  for ( const G4LogicalVolume* volume : *G4LogicalVolumeStore::GetInstance() ) {
+    key << "volume " << volume->GetName() << " "
+        << volume->GetMaterial()->GetName() << " "
+        << ( volume->GetRegion() ? volume->GetRegion()->GetName() : "none" )
+        << "\n";
+  }
+  for ( const G4Region* region : *G4RegionStore::GetInstance() ) {
+    key << "region " << region->GetName();
+    if ( G4ProductionCuts* cuts = region->GetProductionCuts() ) {
+      // gamma, e-, e+, proton
+      for ( G4int i = 0; i < 4; ++i ) key << " " << cuts->GetProductionCut(i)/mm;
+    }
+    key << "\n";
+  }
+  return key.str();
+}
+
+//....oooOO0OOooo........oooOO0OOooo........oooOO0OOooo........oooOO0OOooo......
+
+G4String PhysicsCache::Subdirectory(const G4String& key) const
+{
+  std::ostringstream name;
+  name << fDirectory << "/" << fPhysics << "-" << std::hex
+       << std::hash<std::string>()(key);
+  return name.str();
+}
+
+//....oooOO0OOooo........oooOO0OOooo........oooOO0OOooo........oooOO0OOooo......
+
+G4bool PhysicsCache::ReadStamp(const G4String& directory, G4String& key)
+{
+  std::ifstream stamp((directory + "/" + kStamp).c_str());
+  if ( ! stamp ) return false;
+  key.assign(std::istreambuf_iterator<char>(stamp),
+             std::istreambuf_iterator<char>());
+  return true;
+}
+
+//....oooOO0OOooo........oooOO0OOooo........oooOO0OOooo........oooOO0OOooo......
+
+void PhysicsCache::Remove(const G4String& directory)
+{
+  // StorePhysicsTable writes plain files only
+  if ( DIR* dir = opendir(directory.c_str()) ) {
+    while ( dirent* entry = readdir(dir) ) {
+      G4String name = entry->d_name;
+      if ( name != "." && name != ".." ) {
+        unlink((directory + "/" + name).c_str());
+      }
+    }
+    closedir(dir);
+  }
+  rmdir(directory.c_str());
+}
+
+//....oooOO0OOooo........oooOO0OOooo........oooOO0OOooo........oooOO0OOooo......
@@ -1,20 +1,79 @@
 #include "PrimaryGeneratorAction.hh"
+#include "Checkpoint.hh"
+#include "ResponseMatrix.hh"
 
 #include "G4LogicalVolumeStore.hh"
 #include "G4LogicalVolume.hh"
 #include "G4Box.hh"
 #include "G4RunManager.hh"
+#include "G4Run.hh"
+#include "G4EventManager.hh"
+#include "G4TrackingManager.hh"
+#include "G4Event.hh"
 #include "G4ParticleGun.hh"
 #include "G4ParticleTable.hh"
 #include "G4ParticleDefinition.hh"
+#include "G4Gamma.hh"
+#include "G4PrimaryVertex.hh"
+#include "G4PrimaryParticle.hh"
+#include "G4PhysicalVolumeStore.hh"
+#include "G4VPhysicalVolume.hh"
+#include "G4Tubs.hh"
+#include "G4GenericMessenger.hh"
+#include "G4Exception.hh"
 #include "G4SystemOfUnits.hh"
 #include "G4GeneralParticleSource.hh"
 #include "Randomize.hh"
 
-PrimaryGeneratorAction::PrimaryGeneratorAction()
-: G4VUserPrimaryGeneratorAction()
+#include <algorithm>
+#include <cmath>
+#include <cstdint>
+
+namespace {
+  // splitmix64: consecutive states give statistically independent outputs
+  std::uint64_t SplitMix64(std::uint64_t& state)
+  {
+    std::uint64_t z = ( state += 0x9E3779B97F4A7C15ULL );
+    z = ( z ^ ( z >> 30 ) )*0xBF58476D1CE4E5B9ULL;
+    z = ( z ^ ( z >> 27 ) )*0x94D049BB133111EBULL;
+    return z ^ ( z >> 31 );
+  }
+}
+
+//....oooOO0OOooo........oooOO0OOooo........oooOO0OOooo........oooOO0OOooo......
+
+PrimaryGeneratorAction::PrimaryGeneratorAction(G4long masterSeed,
+                                  const std::vector<G4int>& replayEvents)
+: G4VUserPrimaryGeneratorAction(),
+  fMasterSeed(masterSeed),
+  fReplayEvents(replayEvents),
+  fMode(kGPS),
+  fSpectrumFile("Co60_spectrum.txt"),
+  fGamma(G4Gamma::Definition()),
+  fSource(0),
+  fScintillator(0),
+  fBiasFraction(0.),
+  fResponseMatrix(0),
+  fMessenger(0)
 {
   fParticleGun  = new G4GeneralParticleSource();
+
+  fMessenger = new G4GenericMessenger(this, "/toy/gun/", "Primary generator");
+  auto& modeCmd = fMessenger->DeclareMethod("mode",
+    &PrimaryGeneratorAction::SetMode,
+    "gps: /gps/ commands; cascade: all lines of the spectrum file per decay;"
+    " lines: one line per event");
+  modeCmd.SetParameterName("mode", false);
+  modeCmd.SetCandidates("gps cascade lines");
+  auto& fileCmd = fMessenger->DeclareMethod("spectrum",
+    &PrimaryGeneratorAction::SetSpectrumFile,
+    "Line spectrum file of the cascade and lines generators");
+  fileCmd.SetParameterName("file", false);
+  auto& biasCmd = fMessenger->DeclareProperty("biasFraction", fBiasFraction,
+    "Fraction of the cascade/lines gammas emitted towards the scintillator,"
+    " weighted accordingly (0: isotropic)");
+  biasCmd.SetParameterName("fraction", false);
+  biasCmd.SetRange("fraction>=0. && fraction<1.");
 }
 
 //....oooOO0OOooo........oooOO0OOooo........oooOO0OOooo........oooOO0OOooo......
@@ -22,11 +81,219 @@ PrimaryGeneratorAction::PrimaryGeneratorAction()
 PrimaryGeneratorAction::~PrimaryGeneratorAction()
 {
   delete fParticleGun;
+  delete fMessenger;
+}
+
+//....oooOO0OOooo........oooOO0OOooo........oooOO0OOooo........oooOO0OOooo......
+
+void PrimaryGeneratorAction::SetMode(const G4String& mode)
+{
+  if ( mode == "cascade" ) fMode = kCascade;
+  else if ( mode == "lines" ) fMode = kLines;
+  else fMode = kGPS;
+}
+
+//....oooOO0OOooo........oooOO0OOooo........oooOO0OOooo........oooOO0OOooo......
+
+void PrimaryGeneratorAction::SetSpectrumFile(const G4String& fileName)
+{
+  fSpectrumFile = fileName;
+  fSpectrum = LineSpectrum();   // read again at the next event
+}
+
+//....oooOO0OOooo........oooOO0OOooo........oooOO0OOooo........oooOO0OOooo......
+
+void PrimaryGeneratorAction::SeedEvent(G4long masterSeed, G4int runID,
+                                       G4int eventID)
+{
+  std::uint64_t state = static_cast<std::uint64_t>(masterSeed);
+  state = SplitMix64(state) + static_cast<std::uint64_t>(runID);
+  state = SplitMix64(state) + static_cast<std::uint64_t>(eventID);
+  // Both seeds in the valid (positive) range of RanecuEngine
+  long seeds[3];
+  seeds[0] = static_cast<long>(SplitMix64(state) % 2147483562ULL) + 1;
+  seeds[1] = static_cast<long>(SplitMix64(state) % 2147483398ULL) + 1;
+  seeds[2] = 0;
+  G4Random::setTheSeeds(seeds);
 }
 
 //....oooOO0OOooo........oooOO0OOooo........oooOO0OOooo........oooOO0OOooo......
 
 void PrimaryGeneratorAction::GeneratePrimaries(G4Event* anEvent)
 {
-  fParticleGun->GeneratePrimaryVertex(anEvent);
+  if ( ! fReplayEvents.empty() ) {
+    std::size_t index = anEvent->GetEventID();
+    if ( index >= fReplayEvents.size() ) {
+      // All listed events are done: no primaries, stop this thread
+      G4RunManager::GetRunManager()->AbortRun(true);
+      return;
+    }
+    anEvent->SetEventID(fReplayEvents[index]);
+    G4EventManager::GetEventManager()->GetTrackingManager()->SetVerboseLevel(1);
+    G4cout << "------ Replaying event " << anEvent->GetEventID()
+           << " ------" << G4endl;
+  }
+  else if ( G4int firstEvent = Checkpoint::Instance()->GetFirstEvent() ) {
+    // A chunk of a checkpointed run continues the event IDs of the job
+    anEvent->SetEventID(anEvent->GetEventID() + firstEvent);
+  }
+  // Event IDs restart at 0 in every run: the run keeps the runs apart
+  G4int runID = G4RunManager::GetRunManager()->GetCurrentRun()->GetRunID();
+  SeedEvent(fMasterSeed, Checkpoint::Instance()->GetSeedRun(runID),
+            anEvent->GetEventID());
+  if ( fResponseMatrix && fResponseMatrix->IsEnabled() ) GenerateGridPoint(anEvent);
+  else if ( fMode == kGPS ) fParticleGun->GeneratePrimaryVertex(anEvent);
+  else GenerateDecay(anEvent);
 }
+
+//....oooOO0OOooo........oooOO0OOooo........oooOO0OOooo........oooOO0OOooo......
+
+void PrimaryGeneratorAction::GenerateDecay(G4Event* anEvent)
+{
+  if ( ! fSpectrum.IsLoaded() && ! fSpectrum.Load(fSpectrumFile) ) {
+    G4ExceptionDescription msg;
+    msg << "Cannot read the line spectrum " << fSpectrumFile;
+    G4Exception("PrimaryGeneratorAction::GenerateDecay()",
+      "toyMC_gun001", FatalException, msg);
+    return;
+  }
+
+  G4ThreeVector position = SamplePosition();
+  auto vertex = new G4PrimaryVertex(position, 0.);
+  if ( fMode == kLines ) {
+    vertex->SetPrimary(new G4PrimaryParticle(fGamma));
+    vertex->GetPrimary()->SetKineticEnergy(fSpectrum.Sample());
+  }
+  else {
+    for ( std::size_t i = 0; i < fSpectrum.GetNumberOfLines(); ++i ) {
+      if ( G4UniformRand() >= fSpectrum.GetIntensity(i) ) continue;
+      auto gamma = new G4PrimaryParticle(fGamma);
+      gamma->SetKineticEnergy(fSpectrum.GetEnergy(i));
+      vertex->SetPrimary(gamma);
+    }
+  }
+  for ( G4PrimaryParticle* primary = vertex->GetPrimary(); primary;
+        primary = primary->GetNext() ) {
+    G4double weight;
+    primary->SetMomentumDirection(SampleDirection(position, weight));
+    primary->SetWeight(weight);
+  }
+  anEvent->AddPrimaryVertex(vertex);
+}
+
+//....oooOO0OOooo........oooOO0OOooo........oooOO0OOooo........oooOO0OOooo......
+
+void PrimaryGeneratorAction::GenerateGridPoint(G4Event* anEvent)
+{
+  // One gamma of the grid energy of this event, from the source volume
+  G4ThreeVector position = SamplePosition();
+  auto vertex = new G4PrimaryVertex(position, 0.);
+  auto gamma = new G4PrimaryParticle(fGamma);
+  gamma->SetKineticEnergy(fResponseMatrix->GetEnergy(anEvent->GetEventID()));
+  G4double weight;
+  gamma->SetMomentumDirection(SampleDirection(position, weight));
+  gamma->SetWeight(weight);
+  vertex->SetPrimary(gamma);
+  anEvent->AddPrimaryVertex(vertex);
+}
+
+//....oooOO0OOooo........oooOO0OOooo........oooOO0OOooo........oooOO0OOooo......
+
+G4ThreeVector PrimaryGeneratorAction::SamplePosition()
+{
+  if ( ! fSource ) {
+    fSource = G4PhysicalVolumeStore::GetInstance()->GetVolume("SourceCylinder");
+  }
+  // Uniform in the annulus of the tube, in its local frame
+  auto tubs = static_cast<const G4Tubs*>(fSource->GetLogicalVolume()->GetSolid());
+  G4double rmin2 = tubs->GetInnerRadius()*tubs->GetInnerRadius();
+  G4double rmax2 = tubs->GetOuterRadius()*tubs->GetOuterRadius();
+  G4double r = std::sqrt(rmin2 + G4UniformRand()*(rmax2 - rmin2));
+  G4double phi = twopi*G4UniformRand();
+  G4double z = ( 2.*G4UniformRand() - 1. )*tubs->GetZHalfLength();
+  G4ThreeVector local(r*std::cos(phi), r*std::sin(phi), z);
+
+  // The source is placed directly in the world
+  return fSource->GetObjectRotationValue()*local + fSource->GetObjectTranslation();
+}
+
+//....oooOO0OOooo........oooOO0OOooo........oooOO0OOooo........oooOO0OOooo......
+
+G4ThreeVector PrimaryGeneratorAction::SampleDirection() const
+{
+  G4double cosTheta = 2.*G4UniformRand() - 1.;
+  G4double sinTheta = std::sqrt(1. - cosTheta*cosTheta);
+  G4double phi = twopi*G4UniformRand();
+  return G4ThreeVector(sinTheta*std::cos(phi), sinTheta*std::sin(phi), cosTheta);
+}
+
+//....oooOO0OOooo........oooOO0OOooo........oooOO0OOooo........oooOO0OOooo......
+
+G4ThreeVector PrimaryGeneratorAction::SampleDirection(
+  const G4ThreeVector& position, G4double& weight)
+{
+  weight = 1.;
+  if ( fBiasFraction <= 0. ) return SampleDirection();
+
+  // Cone around the inward normal of the scintillator face in front of the
+  // vertex, just wide enough to contain the box; taken at every event since
+  // the geometry can change between runs
+  if ( ! fScintillator ) {
+    fScintillator = G4PhysicalVolumeStore::GetInstance()->GetVolume("Scintillator");
+  }
+  auto box = static_cast<const G4Box*>(
+    fScintillator->GetLogicalVolume()->GetSolid());
+  const G4ThreeVector half(box->GetXHalfLength(), box->GetYHalfLength(),
+                           box->GetZHalfLength());
+  const G4RotationMatrix rotation = fScintillator->GetObjectRotationValue();
+  const G4ThreeVector local = rotation.inverse()
+    *( position - fScintillator->GetObjectTranslation() );
+
+  // The face whose plane the vertex is farthest outside of separates the
+  // vertex from the box: all directions to the box point through it
+  G4int face = 0;
+  for ( G4int i = 1; i < 3; ++i ) {
+    if ( std::abs(local[i]) - half[i] > std::abs(local[face]) - half[face] ) {
+      face = i;
+    }
+  }
+  if ( std::abs(local[face]) < half[face] ) return SampleDirection();
+  G4ThreeVector localAxis;
+  localAxis[face] = local[face] > 0. ? -1. : 1.;
+
+  // Half-angle of the cone from the corners: at most 90 degrees, reached
+  // for a vertex on the face plane (the half-space towards the box)
+  G4double cosAlpha = 1.;
+  for ( G4int corner = 0; corner < 8; ++corner ) {
+    G4ThreeVector toCorner(corner & 1 ? half.x() : -half.x(),
+                           corner & 2 ? half.y() : -half.y(),
+                           corner & 4 ? half.z() : -half.z());
+    toCorner -= local;
+    if ( toCorner.mag2() > 0. ) {
+      cosAlpha = std::min(cosAlpha, toCorner.unit().dot(localAxis));
+    }
+  }
+  cosAlpha = std::max(cosAlpha, 0.);
+  const G4ThreeVector axis = rotation*localAxis;
+  G4double coneFraction = 0.5*(1. - cosAlpha);
+
+  G4ThreeVector direction;
+  if ( G4UniformRand() < fBiasFraction ) {
+    G4double cosTheta = 1. - G4UniformRand()*(1. - cosAlpha);
+    G4double sinTheta = std::sqrt(1. - cosTheta*cosTheta);
+    G4double phi = twopi*G4UniformRand();
+    direction.set(sinTheta*std::cos(phi), sinTheta*std::sin(phi), cosTheta);
+    direction.rotateUz(axis);
+  }
+  else {
+    direction = SampleDirection();
+  }
+
+  // Sampled density relative to the isotropic one
+  G4double density = 1. - fBiasFraction;
+  if ( direction.dot(axis) >= cosAlpha ) density += fBiasFraction/coneFraction;
+  weight = 1./density;
+  return direction;
+}
+
+//....oooOO0OOooo........oooOO0OOooo........oooOO0OOooo........oooOO0OOooo......
@@ -0,0 +1,204 @@
+/// \file ResponseMatrix.cc
+/// \brief Implementation of the ResponseMatrix class
+
+#include "ResponseMatrix.hh"
+
+#include "G4GenericMessenger.hh"
+#include "G4UnitsTable.hh"
+#include "G4SystemOfUnits.hh"
+#include "G4ios.hh"
+
+#include <fstream>
+#include <sstream>
+
+namespace {
+  // Numbers followed by an optional unit (default MeV)
+  G4bool ParseEnergies(std::istream& in, std::vector<G4double>& values)
+  {
+    std::vector<G4String> tokens;
+    G4String token;
+    while ( in >> token ) tokens.push_back(token);
+    G4double unit = MeV;
+    if ( ! tokens.empty() && G4UnitDefinition::IsUnitDefined(tokens.back()) ) {
+      unit = G4UnitDefinition::GetValueOf(tokens.back());
+      tokens.pop_back();
+    }
+    values.clear();
+    for ( const auto& number : tokens ) {
+      std::istringstream is(number);
+      G4double value;
+      if ( ! ( is >> value ) || ! is.eof() ) return false;
+      values.push_back(value*unit);
+    }
+    return true;
+  }
+}
+
+//....oooOO0OOooo........oooOO0OOooo........oooOO0OOooo........oooOO0OOooo......
+
+ResponseMatrix::ResponseMatrix()
+ : G4VAccumulable("ResponseMatrix"),
+   fEnabled(false),
+   fMessenger(0),
+   fNPhotonBins(500),
+   fPhotonMax(5000)
+{
+  fMessenger = new G4GenericMessenger(this, "/toy/response/",
+                                      "Detector response matrix");
+  fMessenger->DeclareProperty("enable", fEnabled,
+    "Generate mono-energetic gammas on the energy grid and fill the"
+    " response matrix instead of using the /toy/gun/ generator");
+  fMessenger->DeclareProperty("file", fFileName,
+    "File the matrix is saved to (default: <output>.response)");
+  auto& energiesCmd = fMessenger->DeclareMethod("energies",
+    &ResponseMatrix::SetEnergies,
+    "Energy grid: list of energies followed by a unit, e.g. 662 1173 keV");
+  energiesCmd.SetParameterName("energies", false);
+  auto& gridCmd = fMessenger->DeclareMethod("grid", &ResponseMatrix::SetGrid,
+    "Linear energy grid: number of points, first and last energy and unit,"
+    " e.g. 20 50 2000 keV");
+  gridCmd.SetParameterName("grid", false);
+  auto& binCmd = fMessenger->DeclareMethod("photonBins",
+    &ResponseMatrix::SetPhotonBins, "Number of detected-photon bins");
+  binCmd.SetParameterName("n", false);
+  binCmd.SetRange("n>0");
+  auto& maxCmd = fMessenger->DeclareMethod("photonMax",
+    &ResponseMatrix::SetPhotonMax,
+    "Upper edge of the detected-photon bins; more photons are overflow");
+  maxCmd.SetParameterName("max", false);
+  maxCmd.SetRange("max>0");
+}
+
+//....oooOO0OOooo........oooOO0OOooo........oooOO0OOooo........oooOO0OOooo......
+
+ResponseMatrix::~ResponseMatrix()
+{
+  delete fMessenger;
+}
+
+//....oooOO0OOooo........oooOO0OOooo........oooOO0OOooo........oooOO0OOooo......
+
+void ResponseMatrix::SetEnergies(const G4String& list)
+{
+  std::istringstream in(list);
+  std::vector<G4double> energies;
+  if ( ! ParseEnergies(in, energies) || energies.empty() ) {
+    G4ExceptionDescription ed;
+    ed << "Cannot read the energy grid \"" << list << "\"";
+    G4Exception("ResponseMatrix::SetEnergies()", "toyMC_resp001",
+                JustWarning, ed);
+    return;
+  }
+  fEnergies = energies;
+  Book();
+}
+
+//....oooOO0OOooo........oooOO0OOooo........oooOO0OOooo........oooOO0OOooo......
+
+void ResponseMatrix::SetGrid(const G4String& grid)
+{
+  std::istringstream in(grid);
+  G4int n = 0;
+  std::vector<G4double> range;
+  if ( ! ( in >> n ) || n < 1 || ! ParseEnergies(in, range)
+       || range.size() != 2 || range[0] <= 0. || range[1] < range[0] ) {
+    G4ExceptionDescription ed;
+    ed << "Expected points, first and last energy and unit, got \""
+       << grid << "\"";
+    G4Exception("ResponseMatrix::SetGrid()", "toyMC_resp002",
+                JustWarning, ed);
+    return;
+  }
+  fEnergies.resize(n);
+  for ( G4int i = 0; i < n; ++i ) {
+    fEnergies[i] = ( n > 1 ) ? range[0] + i*(range[1] - range[0])/(n - 1)
+                             : range[0];
+  }
+  Book();
+}
+
+//....oooOO0OOooo........oooOO0OOooo........oooOO0OOooo........oooOO0OOooo......
+
+void ResponseMatrix::SetPhotonBins(G4int nbins)
+{
+  fNPhotonBins = nbins;
+  Book();
+}
+
+//....oooOO0OOooo........oooOO0OOooo........oooOO0OOooo........oooOO0OOooo......
+
+void ResponseMatrix::SetPhotonMax(G4int max)
+{
+  fPhotonMax = max;
+  Book();
+}
+
+//....oooOO0OOooo........oooOO0OOooo........oooOO0OOooo........oooOO0OOooo......
+
+void ResponseMatrix::Book()
+{
+  fEvents.assign(fEnergies.size(), 0.);
+  fCounts.assign(fEnergies.size()*(fNPhotonBins + 1), 0.);
+}
+
+//....oooOO0OOooo........oooOO0OOooo........oooOO0OOooo........oooOO0OOooo......
+
+void ResponseMatrix::Merge(const G4VAccumulable& other)
+{
+  const ResponseMatrix& otherMatrix = static_cast<const ResponseMatrix&>(other);
+  if ( otherMatrix.fCounts.size() != fCounts.size() ) return;
+  for ( std::size_t i = 0; i < fEvents.size(); ++i ) {
+    fEvents[i] += otherMatrix.fEvents[i];
+  }
+  for ( std::size_t i = 0; i < fCounts.size(); ++i ) {
+    fCounts[i] += otherMatrix.fCounts[i];
+  }
+}
+
+//....oooOO0OOooo........oooOO0OOooo........oooOO0OOooo........oooOO0OOooo......
+
+void ResponseMatrix::Reset()
+{
+  Book();
+}
+
+//....oooOO0OOooo........oooOO0OOooo........oooOO0OOooo........oooOO0OOooo......
+
+void ResponseMatrix::Fill(G4int eventID, G4int nPhotons, G4double weight)
+{
+  std::size_t energy = eventID % fEnergies.size();
+  G4int bin = ( nPhotons < fPhotonMax )
+    ? G4int(G4double(nPhotons)*fNPhotonBins/fPhotonMax) : fNPhotonBins;
+  fEvents[energy] += weight;
+  fCounts[energy*(fNPhotonBins + 1) + bin] += weight;
+}
+
+//....oooOO0OOooo........oooOO0OOooo........oooOO0OOooo........oooOO0OOooo......
+
+void ResponseMatrix::Save(const G4String& fileName) const
+{
+  std::ofstream out(fileName);
+  if ( ! out ) {
+    G4ExceptionDescription ed;
+    ed << "Cannot write " << fileName;
+    G4Exception("ResponseMatrix::Save()", "toyMC_resp003", JustWarning, ed);
+    return;
+  }
+  out << "# toyMC response matrix: energies in keV, detected photons per event\n"
+      << "energies " << fEnergies.size() << "\n"
+      << "photons " << fNPhotonBins << " " << fPhotonMax << "\n";
+  // one line per energy: energy, events, photon bins, overflow
+  G4double events = 0.;
+  for ( std::size_t i = 0; i < fEnergies.size(); ++i ) {
+    out << fEnergies[i]/keV << " " << fEvents[i];
+    for ( G4int j = 0; j <= fNPhotonBins; ++j ) {
+      out << " " << fCounts[i*(fNPhotonBins + 1) + j];
+    }
+    out << "\n";
+    events += fEvents[i];
+  }
+  G4cout << "Response matrix saved to " << fileName << ": "
+         << fEnergies.size() << " energies, " << events << " events" << G4endl;
+}
+
+//....oooOO0OOooo........oooOO0OOooo........oooOO0OOooo........oooOO0OOooo......
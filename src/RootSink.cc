@@ -0,0 +1,103 @@
+/// \file RootSink.cc
+/// \brief Implementation of the RootSink class
+
+#ifdef TOYMC_WITH_ROOT
+
+#include "RootSink.hh"
+
+#include "TFile.h"
+#include "TTree.h"
+#include "TROOT.h"
+
+//....oooOO0OOooo........oooOO0OOooo........oooOO0OOooo........oooOO0OOooo......
+
+RootSink::RootSink(G4int compression, G4int basketSize)
+ : fCompression(compression),
+   fBasketSize(basketSize),
+   fFile(0),
+   fEventTree(0),
+   fStepTree(0)
+{}
+
+//....oooOO0OOooo........oooOO0OOooo........oooOO0OOooo........oooOO0OOooo......
+
+RootSink::~RootSink()
+{
+  Close();
+}
+
+//....oooOO0OOooo........oooOO0OOooo........oooOO0OOooo........oooOO0OOooo......
+
+G4bool RootSink::Open(const G4String& fileName)
+{
+  // Only the writer thread uses ROOT, but Geant4 threads are running
+  ROOT::EnableThreadSafety();
+  fFile = TFile::Open(fileName.c_str(), "RECREATE", "", fCompression);
+  if ( ! fFile || fFile->IsZombie() ) {
+    delete fFile;
+    fFile = 0;
+    return false;
+  }
+
+  G4int basket = fBasketSize;
+  fEventTree = new TTree("event", "Event summary");
+  fEventTree->Branch("eventID", &fEvent.eventID, "eventID/I", basket);
+  fEventTree->Branch("nPhotons", &fEvent.nPhotons, "nPhotons/I", basket);
+  fEventTree->Branch("firstTime", &fEvent.firstTime, "firstTime/F", basket);
+  fEventTree->Branch("meanTime", &fEvent.meanTime, "meanTime/F", basket);
+  fEventTree->Branch("edep", &fEvent.edep, "edep/F", basket);
+  fEventTree->Branch("primaryE", &fEvent.primaryEnergy, "primaryE/F", basket);
+  fEventTree->Branch("primaryPDG", &fEvent.primaryPDG, "primaryPDG/I", basket);
+  fEventTree->Branch("qTotal", &fEvent.qTotal, "qTotal/F", basket);
+  fEventTree->Branch("qTail", &fEvent.qTail, "qTail/F", basket);
+  fEventTree->Branch("weight", &fEvent.weight, "weight/F", basket);
+
+  fStepTree = new TTree("step", "Energy and Position");
+  fStepTree->Branch("Energy", &fStep.energy, "Energy/F", basket);
+  fStepTree->Branch("prex", &fStep.pre[0], "prex/F", basket);
+  fStepTree->Branch("prey", &fStep.pre[1], "prey/F", basket);
+  fStepTree->Branch("prez", &fStep.pre[2], "prez/F", basket);
+  fStepTree->Branch("postx", &fStep.post[0], "postx/F", basket);
+  fStepTree->Branch("posty", &fStep.post[1], "posty/F", basket);
+  fStepTree->Branch("postz", &fStep.post[2], "postz/F", basket);
+  fStepTree->Branch("pdg", &fStep.pdg, "pdg/I", basket);
+  fStepTree->Branch("eventID", &fStep.eventID, "eventID/I", basket);
+  fStepTree->Branch("trackID", &fStep.trackID, "trackID/I", basket);
+  fStepTree->Branch("parentID", &fStep.parentID, "parentID/I", basket);
+  fStepTree->Branch("dE", &fStep.edep, "dE/F", basket);
+  fStepTree->Branch("weight", &fStep.weight, "weight/F", basket);
+  return true;
+}
+
+//....oooOO0OOooo........oooOO0OOooo........oooOO0OOooo........oooOO0OOooo......
+
+void RootSink::Write(const OutputBatch& batch)
+{
+  for ( const auto& record : batch.events ) {
+    fEvent = record;
+    fEventTree->Fill();
+  }
+  for ( const auto& record : batch.steps ) {
+    fStep = record;
+    fStepTree->Fill();
+  }
+}
+
+//....oooOO0OOooo........oooOO0OOooo........oooOO0OOooo........oooOO0OOooo......
+
+void RootSink::Close()
+{
+  if ( ! fFile ) return;
+  fFile->cd();
+  fEventTree->Write();
+  // An empty step tree means step output was off
+  if ( fStepTree->GetEntries() > 0 ) fStepTree->Write();
+  fFile->Close();
+  delete fFile;   // also deletes the trees
+  fFile = 0;
+  fEventTree = fStepTree = 0;
+}
+
+//....oooOO0OOooo........oooOO0OOooo........oooOO0OOooo........oooOO0OOooo......
+
+#endif
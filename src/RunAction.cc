@@ -4,6 +4,14 @@
 #include "RunAction.hh"
 #include "PrimaryGeneratorAction.hh"
 #include "DetectorConstruction.hh"
+#include "LightMap.hh"
+#include "StepProfile.hh"
+#include "PMTDigitizer.hh"
+#include "Trigger.hh"
+#include "ResponseMatrix.hh"
+#include "AsyncWriter.hh"
+#include "Checkpoint.hh"
+#include "Telemetry.hh"
 // #include "Run.hh"
 
 #include "G4Run.hh"
@@ -16,44 +24,209 @@
 #include "G4AccumulableManager.hh"
 #include "G4LogicalVolumeStore.hh"
 #include "G4LogicalVolume.hh"
+#include "G4PhysicalVolumeStore.hh"
+#include "G4RegionStore.hh"
+#include "G4ProductionCuts.hh"
 #include "G4UnitsTable.hh"
 #include "G4SystemOfUnits.hh"
+#include "G4GenericMessenger.hh"
+#include "G4Material.hh"
+#include "G4MaterialPropertiesTable.hh"
+#include "G4Exception.hh"
+
+#include <fstream>
 //....oooOO0OOooo........oooOO0OOooo........oooOO0OOooo........oooOO0OOooo......
 //G4String m_hDataFilename;
 RunAction::RunAction()
+: fOutputMode(kEventOutput),
+  fMessenger(0),
+  fLightMap(new LightMap),
+  fStepProfile(new StepProfile),
+  fDigitizer(new PMTDigitizer),
+  fTrigger(new Trigger),
+  fResponseMatrix(new ResponseMatrix),
+  fWriterMode(kG4Writer),
+  fOutputFormat(kRootFormat),
+  fOutputBuffer(new OutputBuffer),
+  fMasterSeed(0)
 { 
   auto analysisManager = G4AnalysisManager::Instance();
  // G4AccumulableManager* analysisManager = G4AccumulableManager::Instance();
   analysisManager->SetVerboseLevel(1);
   analysisManager->SetNtupleMerging(true);
+  // Inactive ntuples are neither created nor written
+  analysisManager->SetActivation(true);
+
+  // Event summary, one row per event (see EventRecord)
+  analysisManager->CreateNtuple("event", "Event summary");
+  analysisManager->CreateNtupleIColumn("eventID");
+  analysisManager->CreateNtupleIColumn("nPhotons");
+  analysisManager->CreateNtupleFColumn("firstTime");
+  analysisManager->CreateNtupleFColumn("meanTime");
+  analysisManager->CreateNtupleFColumn("edep");
+  analysisManager->CreateNtupleFColumn("primaryE");  //5
+  analysisManager->CreateNtupleIColumn("primaryPDG");
+  analysisManager->CreateNtupleFColumn("qTotal");
+  analysisManager->CreateNtupleFColumn("qTail");
+  // Filled from the vector at AddNtupleRow, empty unless /toy/digi/waveform
+  analysisManager->CreateNtupleFColumn("waveform", fDigitizer->GetWaveform());
+  analysisManager->CreateNtupleFColumn("weight");   //10
+  analysisManager->FinishNtuple();
 
-  analysisManager->CreateNtuple("event", "Energy and Position");
-  analysisManager->CreateNtupleDColumn("Energy");
-  analysisManager->CreateNtupleDColumn("prex");
-  analysisManager->CreateNtupleDColumn("prey");
-  analysisManager->CreateNtupleDColumn("prez");
-  analysisManager->CreateNtupleDColumn("postx");   
-  analysisManager->CreateNtupleDColumn("posty");    //5
-  analysisManager->CreateNtupleDColumn("postz");
-  analysisManager->CreateNtupleSColumn("ptype");
-  analysisManager->CreateNtupleDColumn("eventID");
-  analysisManager->CreateNtupleDColumn("trackID");
-  analysisManager->CreateNtupleDColumn("parentID");  //10
-  analysisManager->CreateNtupleDColumn("dE"); 
+  // Step-level debug output, one row per step in the Detector
+  analysisManager->CreateNtuple("step", "Energy and Position");
+  analysisManager->CreateNtupleFColumn("Energy");
+  analysisManager->CreateNtupleFColumn("prex");
+  analysisManager->CreateNtupleFColumn("prey");
+  analysisManager->CreateNtupleFColumn("prez");
+  analysisManager->CreateNtupleFColumn("postx");   
+  analysisManager->CreateNtupleFColumn("posty");    //5
+  analysisManager->CreateNtupleFColumn("postz");
+  analysisManager->CreateNtupleIColumn("pdg");
+  analysisManager->CreateNtupleIColumn("eventID");
+  analysisManager->CreateNtupleIColumn("trackID");
+  analysisManager->CreateNtupleIColumn("parentID");  //10
+  analysisManager->CreateNtupleFColumn("dE"); 
+  analysisManager->CreateNtupleFColumn("weight");
   analysisManager->FinishNtuple();
+
+  // Spectra; binning can be changed with /analysis/h1/set and /analysis/h2/set
+  analysisManager->CreateH1("edep", "Deposit in the scintillator [keV]",
+                            200, 0., 2000.);
+  analysisManager->CreateH1("nPhotons", "Detected photons per event",
+                            500, 0., 5000.);
+  analysisManager->CreateH1("arrivalTime", "Photon arrival time [ns]",
+                            400, 0., 400.);
+  analysisManager->CreateH2("nPhotonsVsEdep",
+                            "Detected photons vs deposit [keV]",
+                            100, 0., 2000., 100, 0., 5000.);
+
+  fMessenger = new G4GenericMessenger(this, "/toy/output/", "Output control");
+  auto& modeCmd = fMessenger->DeclareMethod("mode", &RunAction::SetOutputMode,
+    "event: one summary row per event; step: also one row per Detector step;"
+    " hist: spectra only");
+  modeCmd.SetParameterName("mode", false);
+  modeCmd.SetCandidates("event step hist");
+  modeCmd.SetDefaultValue("event");
+  fMessenger->DeclareProperty("file", m_hDataFilename,
+    "Output file name (with extension) of the next run");
+  auto& writerCmd = fMessenger->DeclareMethod("writer",
+    &RunAction::SetWriterMode,
+    "g4: ntuples through G4AnalysisManager; async: records buffered per"
+    " thread and written by a writer thread (see /toy/output/async/)");
+  writerCmd.SetParameterName("writer", false);
+  writerCmd.SetCandidates("g4 async");
+  auto& formatCmd = fMessenger->DeclareMethod("format",
+    &RunAction::SetOutputFormat,
+    "root: ROOT trees; columnar: binary columns with an event index in"
+    " <output>.cols, written by the async writer");
+  formatCmd.SetParameterName("format", false);
+  formatCmd.SetCandidates("root columnar");
+
+  G4AccumulableManager::Instance()->RegisterAccumulable(fLightMap);
+  G4AccumulableManager::Instance()->RegisterAccumulable(fStepProfile);
+  G4AccumulableManager::Instance()->RegisterAccumulable(fTrigger);
+  G4AccumulableManager::Instance()->RegisterAccumulable(fResponseMatrix);
 }
 
 //....oooOO0OOooo........oooOO0OOooo........oooOO0OOooo........oooOO0OOooo......
 
 RunAction::~RunAction()
-{}
+{
+  delete fMessenger;
+  delete fLightMap;
+  delete fStepProfile;
+  delete fDigitizer;
+  delete fTrigger;
+  delete fResponseMatrix;
+  delete fOutputBuffer;
+}
+
+//....oooOO0OOooo........oooOO0OOooo........oooOO0OOooo........oooOO0OOooo......
+
+void RunAction::SetWriterMode(const G4String& mode)
+{
+  fWriterMode = ( mode == "async" ) ? kAsyncWriter : kG4Writer;
+}
+
+//....oooOO0OOooo........oooOO0OOooo........oooOO0OOooo........oooOO0OOooo......
 
-void RunAction::BeginOfRunAction(const G4Run*)
+void RunAction::SetOutputFormat(const G4String& format)
+{
+  fOutputFormat = ( format == "columnar" ) ? kColumnarFormat : kRootFormat;
+}
+
+//....oooOO0OOooo........oooOO0OOooo........oooOO0OOooo........oooOO0OOooo......
+
+void RunAction::SetOutputMode(const G4String& mode)
+{
+  if ( mode == "step" ) fOutputMode = kStepOutput;
+  else if ( mode == "hist" ) fOutputMode = kHistOutput;
+  else fOutputMode = kEventOutput;
+}
+
+//....oooOO0OOooo........oooOO0OOooo........oooOO0OOooo........oooOO0OOooo......
+
+void RunAction::BeginOfRunAction(const G4Run* run)
 {
   G4RunManager::GetRunManager()->SetRandomNumberStore(false);
+  G4AccumulableManager::Instance()->Reset();
+
+  // Material properties are shared: only the master updates them, before
+  // the workers start their event loop
+  if ( IsMaster() ) {
+    auto detector = static_cast<const DetectorConstruction*>(
+      G4RunManager::GetRunManager()->GetUserDetectorConstruction());
+    detector->UpdateScintillationYield();
+    auto runManager = G4RunManager::GetRunManager();
+    Telemetry::Instance()->BeginRun(run->GetRunID(),
+      run->GetNumberOfEventToBeProcessed(), runManager->GetNumberOfThreads());
+
+    // Without a RINDEX in the World no photon reaches the Detector
+    G4VPhysicalVolume* world
+      = G4PhysicalVolumeStore::GetInstance()->GetVolume("World");
+    G4MaterialPropertiesTable* worldMpt
+      = world->GetLogicalVolume()->GetMaterial()->GetMaterialPropertiesTable();
+    if ( fResponseMatrix->IsEnabled()
+         && ! ( worldMpt && worldMpt->GetProperty("RINDEX") ) ) {
+      G4ExceptionDescription ed;
+      ed << "The World material "
+         << world->GetLogicalVolume()->GetMaterial()->GetName()
+         << " has no RINDEX: no photon reaches the Detector and every event of"
+         << " the response matrix has 0 photons (use /toy/det/worldMaterial Air)";
+      G4Exception("RunAction::BeginOfRunAction()", "toyMC_resp004",
+        JustWarning, ed);
+    }
+  }
+
+  if ( fLightMap->GetMode() != LightMap::kOff ) {
+    G4VPhysicalVolume* scintillator
+      = G4PhysicalVolumeStore::GetInstance()->GetVolume("Scintillator");
+    fLightMap->SetVolume(scintillator);
+    fLightMap->SetMaterial(scintillator->GetLogicalVolume()->GetMaterial());
+    if ( fLightMap->GetMode() == LightMap::kFast && ! fLightMap->IsLoaded() ) {
+      fLightMap->Load(fLightMap->GetFileName());
+    }
+  }
+
   auto analysisManager = G4AnalysisManager::Instance();
+  analysisManager->SetNtupleActivation(kEventNtuple, fOutputMode != kHistOutput);
+  analysisManager->SetNtupleActivation(kStepNtuple, fOutputMode == kStepOutput);
 
   G4String filename = m_hDataFilename;//"event.root";
+  if ( UsesAsyncWriter() ) {
+    // Records go to the output file, histograms to a file of their own
+    analysisManager->SetNtupleActivation(kEventNtuple, false);
+    analysisManager->SetNtupleActivation(kStepNtuple, false);
+    filename = GetBaseName() + ".hist.root";
+    if ( IsMaster() ) {
+      auto runManager = G4RunManager::GetRunManager();
+      AsyncWriter::Format format = ( fOutputFormat == kColumnarFormat )
+        ? AsyncWriter::kColumnar : AsyncWriter::kRoot;
+      AsyncWriter::Instance()->Open(m_hDataFilename,
+                                    runManager->GetNumberOfThreads(), format);
+    }
+  }
   analysisManager->OpenFile(filename);
   G4cout << "Using " << analysisManager->GetType() << G4endl;
 
@@ -63,8 +236,33 @@ void RunAction::BeginOfRunAction(const G4Run*)
 
 void RunAction::EndOfRunAction(const G4Run* run)
 {
+  // The workers end their run before the master: their records are all
+  // queued when the master closes the writer
+  if ( UsesAsyncWriter() ) {
+    fOutputBuffer->Flush();
+    if ( IsMaster() ) AsyncWriter::Instance()->Close();
+  }
+
   G4int nofEvents = run->GetNumberOfEvent();
   if (nofEvents == 0) return;
+
+  // Merge the thread-local accumulables into the master ones
+  G4AccumulableManager::Instance()->Merge();
+  if ( IsMaster() && fLightMap->GetMode() == LightMap::kCalibrate ) {
+    fLightMap->Save(fLightMap->GetFileName());
+  }
+  if ( IsMaster() && fResponseMatrix->IsEnabled() ) {
+    G4String fileName = fResponseMatrix->GetFileName();
+    if ( fileName.empty() ) fileName = GetBaseName() + ".response";
+    fResponseMatrix->Save(fileName);
+  }
+  if ( IsMaster() ) {
+    fStepProfile->Print();
+    fTrigger->Print();
+    WriteMetadata(run);
+    Telemetry::Instance()->EndRun();
+  }
+
   auto analysisManager = G4AnalysisManager::Instance();
   analysisManager->Write();
   analysisManager->CloseFile();
@@ -72,3 +270,75 @@ void RunAction::EndOfRunAction(const G4Run* run)
 
 //....oooOO0OOooo........oooOO0OOooo........oooOO0OOooo........oooOO0OOooo......
 
+G4String RunAction::GetBaseName() const
+{
+  G4String baseName = m_hDataFilename;
+  std::size_t dot = baseName.rfind('.');
+  std::size_t slash = baseName.rfind('/');
+  if ( dot != std::string::npos
+       && ( slash == std::string::npos || dot > slash + 1 ) ) {
+    baseName = baseName.substr(0, dot);
+  }
+  return baseName;
+}
+
+//....oooOO0OOooo........oooOO0OOooo........oooOO0OOooo........oooOO0OOooo......
+
+void RunAction::WriteMetadata(const G4Run* run) const
+{
+  // Run settings needed to interpret the output, as "key value" lines in
+  // a sidecar file next to the output: out/1.root -> out/1.meta
+  G4String metaFilename = GetBaseName() + ".meta";
+
+  auto detector = static_cast<const DetectorConstruction*>(
+    G4RunManager::GetRunManager()->GetUserDetectorConstruction());
+  G4VPhysicalVolume* scintillator
+    = G4PhysicalVolumeStore::GetInstance()->GetVolume("Scintillator");
+  G4Material* material = scintillator->GetLogicalVolume()->GetMaterial();
+  G4MaterialPropertiesTable* mpt = material->GetMaterialPropertiesTable();
+
+  const char* outputModes[] = { "event", "step", "hist" };
+  std::ofstream out(metaFilename);
+  out << "output " << m_hDataFilename << "\n"
+      << "runID " << run->GetRunID() << "\n"
+      << "seed " << fMasterSeed << "\n"
+      << "seedRun " << Checkpoint::Instance()->GetSeedRun(run->GetRunID())
+      << "\n"
+      << "events " << run->GetNumberOfEvent() << "\n"
+      << "firstEvent " << Checkpoint::Instance()->GetFirstEvent() << "\n"
+      << "outputMode " << outputModes[fOutputMode] << "\n"
+      << "scintillator " << material->GetName() << "\n"
+      << "world " << scintillator->GetMotherLogical()->GetMaterial()->GetName()
+      << "\n";
+  if ( mpt && mpt->ConstPropertyExists("SCINTILLATIONYIELD") ) {
+    out << "scintillationYield "
+        << mpt->GetConstProperty("SCINTILLATIONYIELD")*MeV << "\n";
+  }
+  if ( mpt && mpt->ConstPropertyExists("RESOLUTIONSCALE") ) {
+    out << "resolutionScale " << mpt->GetConstProperty("RESOLUTIONSCALE") << "\n";
+  }
+  const char* lightMapModes[] = { "off", "calibrate", "fast" };
+  out << "pde " << detector->GetPDE() << "\n"
+      << "yieldPrescale " << detector->GetYieldPrescale() << "\n"
+      << "fastBox " << detector->GetFastOptics() << "\n"
+      << "triggerMinPhotons " << fTrigger->GetMinPhotons() << "\n"
+      << "triggerWindow " << fTrigger->GetWindow()/ns << "\n"
+      << "triggerMinEdep " << fTrigger->GetMinEdep()/keV << "\n"
+      << "triggerAccepted " << fTrigger->GetAccepted() << "\n"
+      << "triggerRejected " << fTrigger->GetRejected() << "\n"
+      << "responseMatrix " << fResponseMatrix->IsEnabled() << "\n"
+      << "lightMapMode " << lightMapModes[fLightMap->GetMode()] << "\n"
+      << "writer " << ( UsesAsyncWriter() ? "async" : "g4" ) << "\n"
+      << "format " << ( fOutputFormat == kColumnarFormat ? "columnar" : "root" )
+      << "\n";
+  // Production cuts (range, mm) of gamma and e-, per region
+  for ( const G4Region* region : *G4RegionStore::GetInstance() ) {
+    const G4ProductionCuts* cuts = region->GetProductionCuts();
+    if ( ! cuts ) continue;
+    out << "cuts." << region->GetName() << " "
+        << cuts->GetProductionCut("gamma")/mm << " "
+        << cuts->GetProductionCut("e-")/mm << "\n";
+  }
+}
+
+//....oooOO0OOooo........oooOO0OOooo........oooOO0OOooo........oooOO0OOooo......
@@ -0,0 +1,23 @@
+/// \file ScintillatorHit.cc
+/// \brief Implementation of the ScintillatorHit class
+
+#include "ScintillatorHit.hh"
+
+G4ThreadLocal G4Allocator<ScintillatorHit>* ScintillatorHitAllocator = 0;
+
+//....oooOO0OOooo........oooOO0OOooo........oooOO0OOooo........oooOO0OOooo......
+
+ScintillatorHit::ScintillatorHit()
+ : G4VHit(),
+   fEdep(0.),
+   fTime(0.)
+{
+  for ( G4int i = 0; i < 3; ++i ) fPos[i] = 0.;
+}
+
+//....oooOO0OOooo........oooOO0OOooo........oooOO0OOooo........oooOO0OOooo......
+
+ScintillatorHit::~ScintillatorHit()
+{}
+
+//....oooOO0OOooo........oooOO0OOooo........oooOO0OOooo........oooOO0OOooo......
@@ -0,0 +1,61 @@
+/// \file ScintillatorSD.cc
+/// \brief Implementation of the ScintillatorSD class
+
+#include "ScintillatorSD.hh"
+
+#include "G4HCofThisEvent.hh"
+#include "G4Step.hh"
+#include "G4SDManager.hh"
+#include "G4OpticalPhoton.hh"
+
+//....oooOO0OOooo........oooOO0OOooo........oooOO0OOooo........oooOO0OOooo......
+
+ScintillatorSD::ScintillatorSD(const G4String& name,
+                               const G4String& hitsCollectionName)
+ : G4VSensitiveDetector(name),
+   fHitsCollection(0),
+   fOpticalPhoton(G4OpticalPhoton::OpticalPhotonDefinition())
+{
+  collectionName.insert(hitsCollectionName);
+}
+
+//....oooOO0OOooo........oooOO0OOooo........oooOO0OOooo........oooOO0OOooo......
+
+ScintillatorSD::~ScintillatorSD()
+{}
+
+//....oooOO0OOooo........oooOO0OOooo........oooOO0OOooo........oooOO0OOooo......
+
+void ScintillatorSD::Initialize(G4HCofThisEvent* hce)
+{
+  // Create hits collection
+  fHitsCollection
+    = new ScintillatorHitsCollection(SensitiveDetectorName, collectionName[0]);
+
+  // Add this collection in hce
+  G4int hcID
+    = G4SDManager::GetSDMpointer()->GetCollectionID(collectionName[0]);
+  hce->AddHitsCollection(hcID, fHitsCollection);
+}
+
+//....oooOO0OOooo........oooOO0OOooo........oooOO0OOooo........oooOO0OOooo......
+
+G4bool ScintillatorSD::ProcessHits(G4Step* step, G4TouchableHistory*)
+{
+  G4double edep = step->GetTotalEnergyDeposit();
+  if ( edep <= 0. ) return false;
+  if ( step->GetTrack()->GetDefinition() == fOpticalPhoton ) return false;
+
+  const G4StepPoint* preStepPoint = step->GetPreStepPoint();
+  ScintillatorHit* hit = new ScintillatorHit();
+  hit->SetEdep(edep);
+  hit->SetTime(preStepPoint->GetGlobalTime());
+  hit->SetPos(0.5*(preStepPoint->GetPosition()
+                   + step->GetPostStepPoint()->GetPosition()));
+
+  fHitsCollection->insert(hit);
+
+  return true;
+}
+
+//....oooOO0OOooo........oooOO0OOooo........oooOO0OOooo........oooOO0OOooo......
@@ -0,0 +1,165 @@
+/// \file StackingAction.cc
+/// \brief Implementation of the StackingAction class
+
+#include "StackingAction.hh"
+#include "ScintillatorHit.hh"
+#include "EventAction.hh"
+#include "OpticalBoxModel.hh"
+#include "DetectorConstruction.hh"
+
+#include "G4Track.hh"
+#include "G4OpticalPhoton.hh"
+#include "G4EventManager.hh"
+#include "G4Event.hh"
+#include "G4HCofThisEvent.hh"
+#include "G4SDManager.hh"
+#include "G4StackManager.hh"
+#include "G4RunManager.hh"
+#include "G4VProcess.hh"
+#include "G4PhysicalVolumeStore.hh"
+#include "G4LogicalVolume.hh"
+#include "G4Material.hh"
+#include "G4GenericMessenger.hh"
+#include "G4SystemOfUnits.hh"
+#include "Randomize.hh"
+
+//....oooOO0OOooo........oooOO0OOooo........oooOO0OOooo........oooOO0OOooo......
+
+StackingAction::StackingAction(EventAction* eventAction)
+: G4UserStackingAction(),
+  fEventAction(eventAction),
+  fOpticalPhoton(G4OpticalPhoton::OpticalPhotonDefinition()),
+  fScintillator(0),
+  fDetector(0),
+  fWorldIsOpaque(false),
+  fCerenkovPDE(1.),
+  fScintillatorHCID(-1),
+  fDeferPhotons(true),
+  fKillFutilePhotons(true),
+  fThreshold(0.),
+  fAbortBelowThreshold(false),
+  fVerbose(0),
+  fMessenger(0)
+{
+  fMessenger = new G4GenericMessenger(this, "/toy/stack/",
+                                      "Optical photon stacking");
+  fMessenger->DeclareProperty("deferPhotons", fDeferPhotons,
+    "Track optical photons only after all charged particles and gammas");
+  fMessenger->DeclareProperty("killFutilePhotons", fKillFutilePhotons,
+    "Kill optical photons created where they cannot reach the Detector");
+  auto& thresholdCmd = fMessenger->DeclarePropertyWithUnit("threshold", "keV",
+    fThreshold, "Drop the optical photons of events with a smaller deposit"
+    " in the scintillator (needs deferPhotons)");
+  thresholdCmd.SetParameterName("threshold", false);
+  thresholdCmd.SetRange("threshold>=0.");
+  fMessenger->DeclareProperty("abortBelowThreshold", fAbortBelowThreshold,
+    "Abort events below threshold instead of only dropping their photons");
+  fMessenger->DeclareProperty("verbose", fVerbose,
+    "1: print the events whose photons are dropped by the threshold");
+}
+
+//....oooOO0OOooo........oooOO0OOooo........oooOO0OOooo........oooOO0OOooo......
+
+StackingAction::~StackingAction()
+{
+  delete fMessenger;
+}
+
+//....oooOO0OOooo........oooOO0OOooo........oooOO0OOooo........oooOO0OOooo......
+
+void StackingAction::PrepareNewEvent()
+{
+  // Photons left over by an aborted event
+  if ( OpticalBoxModel* model = OpticalBoxModel::GetInstance() ) {
+    model->ClearBatch();
+  }
+
+  // The geometry can change between runs, so look it up once per event
+  auto store = G4PhysicalVolumeStore::GetInstance();
+  fScintillator = store->GetVolume("Scintillator", false);
+  fDetector = store->GetVolume("Detector", false);
+  G4VPhysicalVolume* world = store->GetVolume("World");
+  G4MaterialPropertiesTable* mpt
+    = world->GetLogicalVolume()->GetMaterial()->GetMaterialPropertiesTable();
+  fWorldIsOpaque = ! ( mpt && mpt->GetProperty("RINDEX") );
+
+  // Yield prescaling applies the PDE to the scintillation photons only
+  auto detector = static_cast<const DetectorConstruction*>(
+    G4RunManager::GetRunManager()->GetUserDetectorConstruction());
+  fCerenkovPDE = detector->GetYieldPrescale() ? detector->GetPDE() : 1.;
+}
+
+//....oooOO0OOooo........oooOO0OOooo........oooOO0OOooo........oooOO0OOooo......
+
+G4ClassificationOfNewTrack
+StackingAction::ClassifyNewTrack(const G4Track* track)
+{
+  if ( track->GetDefinition() != fOpticalPhoton ) return fUrgent;
+
+  if ( fKillFutilePhotons && fWorldIsOpaque ) {
+    const G4VPhysicalVolume* volume = track->GetVolume();
+    if ( volume && volume != fScintillator && volume != fDetector ) return fKill;
+  }
+  // Photons leaving the fast box model were thinned and counted when first
+  // stacked
+  if ( ! OpticalBoxModel::IsHandedBack(track) ) {
+    if ( fCerenkovPDE < 1. ) {
+      const G4VProcess* creator = track->GetCreatorProcess();
+      if ( creator && creator->GetProcessName() == "Cerenkov"
+           && G4UniformRand() >= fCerenkovPDE ) return fKill;
+    }
+    fEventAction->CountPhoton();
+  }
+  return fDeferPhotons ? fWaiting : fUrgent;
+}
+
+//....oooOO0OOooo........oooOO0OOooo........oooOO0OOooo........oooOO0OOooo......
+
+void StackingAction::NewStage()
+{
+  // Stage 0 is over: everything but the optical photons has been tracked.
+  // The stack manager has already moved the waiting photons to the urgent
+  // stack when it calls NewStage.
+  if ( fThreshold <= 0. || ! fDeferPhotons ) return;
+  G4int nPhotons = stackManager->GetNUrgentTrack();
+  if ( nPhotons == 0 && ! fAbortBelowThreshold ) return;
+
+  G4double edep = ScintillatorDeposit();
+  if ( edep < fThreshold ) {
+    if ( fVerbose > 0 ) {
+      G4cout << "Event "
+             << G4EventManager::GetEventManager()->GetConstCurrentEvent()
+                  ->GetEventID()
+             << ": " << edep/keV << " keV in the scintillator, "
+             << nPhotons << " optical photons dropped"
+             << ( fAbortBelowThreshold ? ", event aborted" : "" ) << G4endl;
+    }
+    if ( fAbortBelowThreshold ) {
+      G4EventManager::GetEventManager()->AbortCurrentEvent();
+    }
+    stackManager->clear();
+  }
+}
+
+//....oooOO0OOooo........oooOO0OOooo........oooOO0OOooo........oooOO0OOooo......
+
+G4double StackingAction::ScintillatorDeposit()
+{
+  if ( fScintillatorHCID < 0 ) {
+    fScintillatorHCID
+      = G4SDManager::GetSDMpointer()->GetCollectionID("ScintillatorHitsCollection");
+  }
+  const G4Event* event = G4EventManager::GetEventManager()->GetConstCurrentEvent();
+  G4HCofThisEvent* hce = event->GetHCofThisEvent();
+  if ( ! hce ) return 0.;
+  auto hitsCollection
+    = static_cast<ScintillatorHitsCollection*>(hce->GetHC(fScintillatorHCID));
+  if ( ! hitsCollection ) return 0.;
+
+  G4double edep = 0.;
+  std::size_t nofHits = hitsCollection->entries();
+  for ( std::size_t i = 0; i < nofHits; ++i ) edep += (*hitsCollection)[i]->GetEdep();
+  return edep;
+}
+
+//....oooOO0OOooo........oooOO0OOooo........oooOO0OOooo........oooOO0OOooo......
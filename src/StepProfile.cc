@@ -0,0 +1,159 @@
+/// \file StepProfile.cc
+/// \brief Implementation of the StepProfile class
+
+#include "StepProfile.hh"
+
+#include "G4GenericMessenger.hh"
+#include "G4Step.hh"
+#include "G4Track.hh"
+#include "G4VProcess.hh"
+#include "G4VPhysicalVolume.hh"
+#include "G4ParticleDefinition.hh"
+#include "G4ios.hh"
+
+#include <algorithm>
+#include <iomanip>
+#include <vector>
+
+//....oooOO0OOooo........oooOO0OOooo........oooOO0OOooo........oooOO0OOooo......
+
+StepProfile::StepProfile()
+ : G4VAccumulable("StepProfile"),
+   fEnabled(false),
+   fMessenger(0),
+   fParticle(0),
+   fProcess(0),
+   fLastVolume(0),
+   fVolume(0)
+{
+  fMessenger = new G4GenericMessenger(this, "/toy/profile/",
+                                      "Step and track profiling");
+  fMessenger->DeclareProperty("enable", fEnabled,
+    "Count steps, tracks and time per volume, particle and creator process");
+}
+
+//....oooOO0OOooo........oooOO0OOooo........oooOO0OOooo........oooOO0OOooo......
+
+StepProfile::~StepProfile()
+{
+  delete fMessenger;
+}
+
+//....oooOO0OOooo........oooOO0OOooo........oooOO0OOooo........oooOO0OOooo......
+
+void StepProfile::Merge(const G4VAccumulable& other)
+{
+  const StepProfile& otherProfile = static_cast<const StepProfile&>(other);
+  MergeTable(fVolumes, otherProfile.fVolumes);
+  MergeTable(fParticles, otherProfile.fParticles);
+  MergeTable(fProcesses, otherProfile.fProcesses);
+}
+
+//....oooOO0OOooo........oooOO0OOooo........oooOO0OOooo........oooOO0OOooo......
+
+void StepProfile::MergeTable(Table& table, const Table& other)
+{
+  for ( const auto& entry : other ) {
+    Entry& mine = table[entry.first];
+    mine.steps += entry.second.steps;
+    mine.tracks += entry.second.tracks;
+    mine.time += entry.second.time;
+  }
+}
+
+//....oooOO0OOooo........oooOO0OOooo........oooOO0OOooo........oooOO0OOooo......
+
+void StepProfile::Reset()
+{
+  fVolumes.clear();
+  fParticles.clear();
+  fProcesses.clear();
+  fParticle = 0;
+  fProcess = 0;
+  fLastVolume = 0;
+  fVolume = 0;
+}
+
+//....oooOO0OOooo........oooOO0OOooo........oooOO0OOooo........oooOO0OOooo......
+
+void StepProfile::StartTrack(const G4Track* track)
+{
+  // Map nodes are stable, so the entries of the track can be kept
+  fParticle = &fParticles[track->GetDefinition()->GetParticleName()];
+  const G4VProcess* creator = track->GetCreatorProcess();
+  fProcess = &fProcesses[creator ? creator->GetProcessName() : "primary"];
+  ++fParticle->tracks;
+  ++fProcess->tracks;
+
+  const G4VPhysicalVolume* volume = track->GetVolume();
+  if ( volume ) ++fVolumes[volume->GetName()].tracks;
+  fLastTime = Clock::now();
+}
+
+//....oooOO0OOooo........oooOO0OOooo........oooOO0OOooo........oooOO0OOooo......
+
+void StepProfile::CountStep(const G4Step* step)
+{
+  Clock::time_point now = Clock::now();
+  G4double time = std::chrono::duration<G4double>(now - fLastTime).count();
+  fLastTime = now;
+
+  const G4VPhysicalVolume* volume = step->GetPreStepPoint()->GetPhysicalVolume();
+  if ( volume != fLastVolume ) {
+    fLastVolume = volume;
+    fVolume = &fVolumes[volume ? volume->GetName() : G4String("none")];
+  }
+  ++fVolume->steps;
+  fVolume->time += time;
+  if ( fParticle ) {
+    ++fParticle->steps;
+    fParticle->time += time;
+    ++fProcess->steps;
+    fProcess->time += time;
+  }
+}
+
+//....oooOO0OOooo........oooOO0OOooo........oooOO0OOooo........oooOO0OOooo......
+
+void StepProfile::Print() const
+{
+  if ( ! fEnabled ) return;
+  G4cout << G4endl << "--------------------- Step profile ---------------------"
+         << G4endl;
+  PrintTable("volume", fVolumes);
+  PrintTable("particle", fParticles);
+  PrintTable("creator process", fProcesses);
+}
+
+//....oooOO0OOooo........oooOO0OOooo........oooOO0OOooo........oooOO0OOooo......
+
+void StepProfile::PrintTable(const G4String& title, const Table& table) const
+{
+  G4double totalTime = 0.;
+  std::vector<const Table::value_type*> rows;
+  for ( const auto& entry : table ) {
+    totalTime += entry.second.time;
+    rows.push_back(&entry);
+  }
+  std::sort(rows.begin(), rows.end(),
+    [](const Table::value_type* a, const Table::value_type* b)
+    { return a->second.time > b->second.time; });
+
+  G4cout << std::setw(20) << std::left << title << std::right
+         << std::setw(14) << "steps" << std::setw(12) << "tracks"
+         << std::setw(12) << "time [s]" << std::setw(8) << "time %"
+         << std::setw(12) << "ns/step" << G4endl;
+  for ( auto row : rows ) {
+    const Entry& entry = row->second;
+    G4cout << std::setw(20) << std::left << row->first << std::right
+           << std::setw(14) << entry.steps << std::setw(12) << entry.tracks
+           << std::setw(12) << std::fixed << std::setprecision(3) << entry.time
+           << std::setw(8) << std::setprecision(1)
+           << ( totalTime > 0. ? 100.*entry.time/totalTime : 0. )
+           << std::setw(12) << std::setprecision(1)
+           << ( entry.steps ? 1.e9*entry.time/entry.steps : 0. ) << G4endl;
+  }
+  G4cout << std::defaultfloat << G4endl;
+}
+
+//....oooOO0OOooo........oooOO0OOooo........oooOO0OOooo........oooOO0OOooo......
@@ -0,0 +1,173 @@
+/// \file Telemetry.cc
+/// \brief Implementation of the Telemetry class
+
+#include "Telemetry.hh"
+
+#include "G4GenericMessenger.hh"
+#include "G4Threading.hh"
+#include "G4SystemOfUnits.hh"
+
+#include <sys/resource.h>
+#include <algorithm>
+#include <cstdio>
+#include <fstream>
+#include <iomanip>
+
+//....oooOO0OOooo........oooOO0OOooo........oooOO0OOooo........oooOO0OOooo......
+
+Telemetry* Telemetry::Instance()
+{
+  // Never deleted: its commands must outlive the UI manager
+  static Telemetry* instance = new Telemetry();
+  return instance;
+}
+
+//....oooOO0OOooo........oooOO0OOooo........oooOO0OOooo........oooOO0OOooo......
+
+Telemetry::Telemetry()
+ : fInterval(10.*s),
+   fMessenger(0),
+   fProcessStart(Clock::now()),
+   fInitTime(-1.),
+   fRunID(-1),
+   fEventsToProcess(0),
+   fNSlots(1),
+   fCounters(new Counters[1]),
+   fRunStart(Clock::now()),
+   fNextWrite(0)
+{
+  fMessenger = new G4GenericMessenger(this, "/toy/telemetry/", "Run telemetry");
+  auto& fileCmd = fMessenger->DeclareProperty("file", fFileName,
+    "JSON file with the run progress, rewritten periodically (empty: off)");
+  fileCmd.SetToBeBroadcasted(false);
+  auto& intervalCmd = fMessenger->DeclarePropertyWithUnit("interval", "s",
+    fInterval, "Time between two updates of the telemetry file");
+  intervalCmd.SetRange("interval>0.");
+  intervalCmd.SetToBeBroadcasted(false);
+}
+
+//....oooOO0OOooo........oooOO0OOooo........oooOO0OOooo........oooOO0OOooo......
+
+Telemetry::~Telemetry()
+{
+  delete fMessenger;
+}
+
+//....oooOO0OOooo........oooOO0OOooo........oooOO0OOooo........oooOO0OOooo......
+
+G4int Telemetry::Slot() const
+{
+  // Workers have ids 0..n-1; the master (or a sequential run) uses slot 0
+  G4int id = G4Threading::G4GetThreadId();
+  return ( id > 0 && id < fNSlots ) ? id : 0;
+}
+
+//....oooOO0OOooo........oooOO0OOooo........oooOO0OOooo........oooOO0OOooo......
+
+void Telemetry::BeginRun(G4int runID, G4long eventsToProcess, G4int nThreads)
+{
+  fRunID = runID;
+  fEventsToProcess = eventsToProcess;
+  fNSlots = std::max(nThreads, 1);
+  fCounters.reset(new Counters[fNSlots]);
+  fRunStart = Clock::now();
+  if ( fInitTime < 0. ) {
+    fInitTime = std::chrono::duration<G4double>(fRunStart - fProcessStart).count();
+    G4cout << "Initialization took " << fInitTime << " s" << G4endl;
+  }
+  auto interval = std::chrono::duration_cast<Clock::duration>(
+    std::chrono::duration<G4double>(fInterval/s));
+  fNextWrite = ( fRunStart + interval ).time_since_epoch().count();
+}
+
+//....oooOO0OOooo........oooOO0OOooo........oooOO0OOooo........oooOO0OOooo......
+
+void Telemetry::EndRun()
+{
+  std::lock_guard<std::mutex> lock(fWriteMutex);
+  Write();
+}
+
+//....oooOO0OOooo........oooOO0OOooo........oooOO0OOooo........oooOO0OOooo......
+
+void Telemetry::EventDone(G4long nSteps, G4long nPhotons)
+{
+  Counters& counters = fCounters[Slot()];
+  counters.events.fetch_add(1, std::memory_order_relaxed);
+  counters.steps.fetch_add(nSteps, std::memory_order_relaxed);
+  counters.photons.fetch_add(nPhotons, std::memory_order_relaxed);
+  if ( fFileName.empty() ) return;
+
+  // One clock read per event; the thread that wins the lock writes
+  Clock::rep now = Clock::now().time_since_epoch().count();
+  if ( now < fNextWrite.load(std::memory_order_relaxed) ) return;
+  std::unique_lock<std::mutex> lock(fWriteMutex, std::try_to_lock);
+  if ( ! lock.owns_lock() ) return;
+  auto interval = std::chrono::duration_cast<Clock::duration>(
+    std::chrono::duration<G4double>(fInterval/s));
+  fNextWrite = now + interval.count();
+  Write();
+}
+
+//....oooOO0OOooo........oooOO0OOooo........oooOO0OOooo........oooOO0OOooo......
+
+G4long Telemetry::PeakRSS()
+{
+  struct rusage usage;
+  getrusage(RUSAGE_SELF, &usage);
+  return usage.ru_maxrss;   // kB on Linux
+}
+
+//....oooOO0OOooo........oooOO0OOooo........oooOO0OOooo........oooOO0OOooo......
+
+void Telemetry::Write()
+{
+  if ( fFileName.empty() ) return;
+
+  G4double elapsed
+    = std::chrono::duration<G4double>(Clock::now() - fRunStart).count();
+  G4long events = 0, steps = 0, photons = 0;
+  for ( G4int i = 0; i < fNSlots; ++i ) {
+    events += fCounters[i].events.load(std::memory_order_relaxed);
+    steps += fCounters[i].steps.load(std::memory_order_relaxed);
+    photons += fCounters[i].photons.load(std::memory_order_relaxed);
+  }
+  G4double rate = ( elapsed > 0. ) ? events/elapsed : 0.;
+  G4double eta = ( rate > 0. ) ? ( fEventsToProcess - events )/rate : -1.;
+
+  G4String tmpName = fFileName + ".tmp";
+  std::ofstream out(tmpName);
+  out << std::fixed << std::setprecision(3)
+      << "{\n"
+      << "  \"run\": " << fRunID << ",\n"
+      << "  \"init_s\": " << fInitTime << ",\n"
+      << "  \"elapsed_s\": " << elapsed << ",\n"
+      << "  \"events_to_process\": " << fEventsToProcess << ",\n"
+      << "  \"events_done\": " << events << ",\n"
+      << "  \"events_per_s\": " << rate << ",\n"
+      << "  \"steps\": " << steps << ",\n"
+      << "  \"steps_per_s\": " << ( elapsed > 0. ? steps/elapsed : 0. ) << ",\n"
+      << "  \"optical_photons\": " << photons << ",\n"
+      << "  \"optical_photons_per_s\": "
+      << ( elapsed > 0. ? photons/elapsed : 0. ) << ",\n"
+      << "  \"eta_s\": " << eta << ",\n"
+      << "  \"peak_rss_kb\": " << PeakRSS() << ",\n"
+      << "  \"threads\": [";
+  for ( G4int i = 0; i < fNSlots; ++i ) {
+    G4long threadEvents = fCounters[i].events.load(std::memory_order_relaxed);
+    G4long threadSteps = fCounters[i].steps.load(std::memory_order_relaxed);
+    G4long threadPhotons = fCounters[i].photons.load(std::memory_order_relaxed);
+    out << ( i ? ",\n" : "\n" )
+        << "    { \"id\": " << i
+        << ", \"events_done\": " << threadEvents
+        << ", \"events_per_s\": " << ( elapsed > 0. ? threadEvents/elapsed : 0. )
+        << ", \"steps_per_s\": " << ( elapsed > 0. ? threadSteps/elapsed : 0. )
+        << ", \"optical_photons_per_s\": "
+        << ( elapsed > 0. ? threadPhotons/elapsed : 0. ) << " }";
+  }
+  out << "\n  ]\n}\n";
+  out.close();
+  std::rename(tmpName.c_str(), fFileName.c_str());
+}
+
+//....oooOO0OOooo........oooOO0OOooo........oooOO0OOooo........oooOO0OOooo......
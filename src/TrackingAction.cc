@@ -0,0 +1,45 @@
+/// \file TrackingAction.cc
+/// \brief Implementation of the TrackingAction class
+
+#include "TrackingAction.hh"
+#include "StepProfile.hh"
+#include "OpticalBoxModel.hh"
+
+#include "G4Track.hh"
+#include "G4TrackingManager.hh"
+#include "G4EventManager.hh"
+#include "G4StackManager.hh"
+
+//....oooOO0OOooo........oooOO0OOooo........oooOO0OOooo........oooOO0OOooo......
+
+TrackingAction::TrackingAction(StepProfile* profile)
+: G4UserTrackingAction(),
+  fProfile(profile)
+{}
+
+//....oooOO0OOooo........oooOO0OOooo........oooOO0OOooo........oooOO0OOooo......
+
+TrackingAction::~TrackingAction()
+{}
+
+//....oooOO0OOooo........oooOO0OOooo........oooOO0OOooo........oooOO0OOooo......
+
+void TrackingAction::PreUserTrackingAction(const G4Track* track)
+{
+  if ( fProfile->IsEnabled() ) fProfile->StartTrack(track);
+}
+
+//....oooOO0OOooo........oooOO0OOooo........oooOO0OOooo........oooOO0OOooo......
+
+void TrackingAction::PostUserTrackingAction(const G4Track*)
+{
+  // The stacks are empty and this track leaves no secondaries: the event
+  // would end here, so trace the photons still held by the fast model
+  OpticalBoxModel* model = OpticalBoxModel::GetInstance();
+  if ( ! model || model->GetBatchSize() == 0 ) return;
+  if ( G4EventManager::GetEventManager()->GetStackManager()->GetNTotalTrack() > 0
+       || ! fpTrackingManager->GimmeSecondaries()->empty() ) return;
+  model->TraceBatch();
+}
+
+//....oooOO0OOooo........oooOO0OOooo........oooOO0OOooo........oooOO0OOooo......
@@ -0,0 +1,119 @@
+/// \file Trigger.cc
+/// \brief Implementation of the Trigger class
+
+#include "Trigger.hh"
+
+#include "G4GenericMessenger.hh"
+#include "G4SystemOfUnits.hh"
+#include "G4UnitsTable.hh"
+#include "G4ios.hh"
+
+#include <algorithm>
+
+//....oooOO0OOooo........oooOO0OOooo........oooOO0OOooo........oooOO0OOooo......
+
+Trigger::Trigger()
+ : G4VAccumulable("Trigger"),
+   fMinPhotons(0),
+   fWindow(100.*ns),
+   fMinEdep(0.),
+   fMessenger(0),
+   fAccepted(0),
+   fRejected(0)
+{
+  fMessenger = new G4GenericMessenger(this, "/toy/trigger/",
+                                      "Output trigger");
+  auto& photonsCmd = fMessenger->DeclareProperty("minPhotons", fMinPhotons,
+    "Write only events with at least this many detected photons within the"
+    " trigger window (0: no photon condition)");
+  photonsCmd.SetParameterName("minPhotons", false);
+  photonsCmd.SetRange("minPhotons>=0");
+  auto& windowCmd = fMessenger->DeclarePropertyWithUnit("window", "ns",
+    fWindow, "Coincidence window of the photon condition");
+  windowCmd.SetParameterName("window", false);
+  windowCmd.SetRange("window>0.");
+  auto& edepCmd = fMessenger->DeclarePropertyWithUnit("minEdep", "keV",
+    fMinEdep, "Write only events with at least this deposit in the"
+    " scintillator (0: no deposit condition)");
+  edepCmd.SetParameterName("minEdep", false);
+  edepCmd.SetRange("minEdep>=0.");
+}
+
+//....oooOO0OOooo........oooOO0OOooo........oooOO0OOooo........oooOO0OOooo......
+
+Trigger::~Trigger()
+{
+  delete fMessenger;
+}
+
+//....oooOO0OOooo........oooOO0OOooo........oooOO0OOooo........oooOO0OOooo......
+
+void Trigger::Merge(const G4VAccumulable& other)
+{
+  const Trigger& otherTrigger = static_cast<const Trigger&>(other);
+  fAccepted += otherTrigger.fAccepted;
+  fRejected += otherTrigger.fRejected;
+}
+
+//....oooOO0OOooo........oooOO0OOooo........oooOO0OOooo........oooOO0OOooo......
+
+void Trigger::Reset()
+{
+  fAccepted = 0;
+  fRejected = 0;
+}
+
+//....oooOO0OOooo........oooOO0OOooo........oooOO0OOooo........oooOO0OOooo......
+
+G4bool Trigger::Accept(const std::vector<G4double>& photonTimes, G4double edep)
+{
+  G4bool accept = ( edep >= fMinEdep );
+  if ( accept && fMinPhotons > 0 ) {
+    accept = ( MaxPhotonsInWindow(photonTimes) >= fMinPhotons );
+  }
+  if ( accept ) ++fAccepted;
+  else ++fRejected;
+  return accept;
+}
+
+//....oooOO0OOooo........oooOO0OOooo........oooOO0OOooo........oooOO0OOooo......
+
+G4int Trigger::MaxPhotonsInWindow(const std::vector<G4double>& photonTimes)
+{
+  if ( photonTimes.size() < std::size_t(fMinPhotons) ) return photonTimes.size();
+
+  // Largest number of photons in [t, t + window] over the photon times t
+  fSortedTimes.assign(photonTimes.begin(), photonTimes.end());
+  std::sort(fSortedTimes.begin(), fSortedTimes.end());
+  std::size_t maxCount = 0;
+  std::size_t first = 0;
+  for ( std::size_t last = 0; last < fSortedTimes.size(); ++last ) {
+    while ( fSortedTimes[last] - fSortedTimes[first] > fWindow ) ++first;
+    maxCount = std::max(maxCount, last - first + 1);
+    if ( maxCount >= std::size_t(fMinPhotons) ) break;
+  }
+  return maxCount;
+}
+
+//....oooOO0OOooo........oooOO0OOooo........oooOO0OOooo........oooOO0OOooo......
+
+void Trigger::Print() const
+{
+  if ( ! IsEnabled() ) return;
+  G4long total = fAccepted + fRejected;
+  G4cout << G4endl << "--------------------- Trigger ---------------------"
+         << G4endl;
+  if ( fMinPhotons > 0 ) {
+    G4cout << " >= " << fMinPhotons << " photons within "
+           << G4BestUnit(fWindow, "Time") << G4endl;
+  }
+  if ( fMinEdep > 0. ) {
+    G4cout << " deposit >= " << G4BestUnit(fMinEdep, "Energy") << G4endl;
+  }
+  G4cout << " accepted " << fAccepted << ", rejected " << fRejected
+         << " of " << total << " events ("
+         << ( total > 0 ? 100.*fAccepted/total : 0. ) << "% written)"
+         << G4endl << G4endl;
+}
+
+//....oooOO0OOooo........oooOO0OOooo........oooOO0OOooo........oooOO0OOooo......
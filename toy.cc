@@ -1,78 +1,223 @@
 #include "DetectorConstruction.hh"
 #include "ActionInitialization.hh"
+#include "Telemetry.hh"
+#include "AsyncWriter.hh"
+#include "Checkpoint.hh"
+#include "PhysicsCache.hh"
 
 #ifdef G4MULTITHREADED
 #include "G4MTRunManager.hh"
+#include "G4Threading.hh"
 #else
 #include "G4RunManager.hh"
 #endif
 
 #include "G4UImanager.hh"
 #include "QBBC.hh"
+#include "LeanPhysicsList.hh"
 
 #include "G4VisExecutive.hh"
 #include "G4OpticalPhysics.hh"
+#include "G4FastSimulationPhysics.hh"
 #include "G4UIExecutive.hh"
 #include <sys/time.h>
+#include <cstdlib>
+#include <sstream>
+#include <vector>
 #include "Randomize.hh"
 
 //....oooOO0OOooo........oooOO0OOooo........oooOO0OOooo........oooOO0OOooo......
 
+namespace {
+  void PrintUsage()
+  {
+    G4cerr << " Usage: " << G4endl
+           << " toyMC [macro [outfile]] [-t nThreads] [-s seed]"
+           << " [-r eventID,eventID,...]" << G4endl
+           << "   -t  number of worker threads (default: $TOYMC_NTHREADS,"
+           << " or all cores)" << G4endl
+           << "   -s  master seed (default: from the clock)" << G4endl
+           << "   -r  re-simulate only these events of every run of the job"
+           << " with the same" << G4endl
+           << "       macro and seed, with tracking verbose and step output"
+           << G4endl
+           << "   -c  physics table cache directory (default:"
+           << " $TOYMC_PHYSICS_CACHE, none)" << G4endl
+           << "   -p  physics list: qbbc, em4 or livermore (default:"
+           << " $TOYMC_PHYSICS, qbbc)" << G4endl
+           << "   --resume  continue /toy/checkpoint/beamOn from outfile.ckpt"
+           << " if it exists" << G4endl;
+  }
+}
+
+//....oooOO0OOooo........oooOO0OOooo........oooOO0OOooo........oooOO0OOooo......
+
 int main(int argc,char** argv)
 {
-  // Detect interactive mode (if no arguments) and define UI session
+  // Start the clock of the initialization time; also creates the telemetry
+  // writer and checkpoint commands on the master
+  Telemetry::Instance();
+  AsyncWriter::Instance();
+  Checkpoint::Instance();
+
+  // Parse command line: positional arguments are the macro and the output
+  // file name, options may appear anywhere
+  //
+  std::vector<G4String> args;
+  G4int nThreads = 0;
+  G4long seed = -1;
+  std::vector<G4int> replayEvents;
+  G4String physicsCache;
+  G4bool resume = false;
+  G4String physics = "qbbc";
+  if ( const char* env = std::getenv("TOYMC_PHYSICS") ) {
+    physics = env;
+  }
+  if ( const char* env = std::getenv("TOYMC_PHYSICS_CACHE") ) {
+    physicsCache = env;
+  }
+  if ( const char* env = std::getenv("TOYMC_NTHREADS") ) {
+    nThreads = std::atoi(env);
+  }
+  for ( G4int i = 1; i < argc; ++i ) {
+    G4String arg = argv[i];
+    if ( arg == "-t" && i+1 < argc ) nThreads = std::atoi(argv[++i]);
+    else if ( arg == "-s" && i+1 < argc ) seed = std::atol(argv[++i]);
+    else if ( arg == "-c" && i+1 < argc ) physicsCache = argv[++i];
+    else if ( arg == "-p" && i+1 < argc ) physics = argv[++i];
+    else if ( arg == "--resume" ) resume = true;
+    else if ( arg == "-r" && i+1 < argc ) {
+      std::istringstream list(argv[++i]);
+      G4String id;
+      while ( std::getline(list, id, ',') ) {
+        if ( ! id.empty() ) replayEvents.push_back(std::atoi(id.c_str()));
+      }
+    }
+    else if ( arg == "-h" || arg == "--help" ) { PrintUsage(); return 0; }
+    else args.push_back(arg);
+  }
+  if ( physics != "qbbc" && physics != "em4" && physics != "livermore" ) {
+    G4cerr << "Unknown physics list " << physics << G4endl;
+    PrintUsage();
+    return 1;
+  }
+
+  // Detect interactive mode (if no macro) and define UI session
   //
   G4UIExecutive* ui = 0;
-  if ( argc == 1 ) {
+  if ( args.empty() ) {
     ui = new G4UIExecutive(argc, argv);
   }
-  struct timeval hTimeValue;
-  gettimeofday(&hTimeValue, NULL);
-  G4int m_hRanSeed = hTimeValue.tv_usec;
+  // The master seed drives the whole job: every event is seeded from it, its
+  // run ID and its event ID (PrimaryGeneratorAction::SeedEvent), so a job is
+  // reproduced by its seed and any event by its seed, run and ID, whatever
+  // the threads.
+  // A resumed job takes the seed of its checkpoint
+  if ( resume && args.size() > 1 ) {
+    G4String checkpoint = args[1] + ".ckpt";
+    if ( Checkpoint::Instance()->Load(checkpoint) ) {
+      if ( seed >= 0 && seed != Checkpoint::Instance()->GetSeed() ) {
+        G4cout << "Ignoring -s " << seed << ", resuming with the seed of "
+               << checkpoint << G4endl;
+      }
+      seed = Checkpoint::Instance()->GetSeed();
+    }
+    else {
+      G4cout << "No checkpoint " << checkpoint << ", starting a new job"
+             << G4endl;
+    }
+  }
+  if ( seed < 0 ) {
+    struct timeval hTimeValue;
+    gettimeofday(&hTimeValue, NULL);
+    seed = hTimeValue.tv_usec;
+  }
   CLHEP::HepRandom::setTheEngine(new CLHEP::RanecuEngine);
   G4cout << "Initialize random numbers with seed = "
-         << m_hRanSeed << G4endl;
-  CLHEP::HepRandom::setTheSeed(m_hRanSeed);
+         << seed << G4endl;
+  CLHEP::HepRandom::setTheSeed(seed);
+  Checkpoint::Instance()->SetMasterSeed(seed);
   auto actioninitial = new ActionInitialization();
+  actioninitial->SetMasterSeed(seed);
+  actioninitial->SetReplayEvents(replayEvents);
   G4UImanager* UImanager = G4UImanager::GetUIpointer();
-  if ( (! ui) &&  (argc > 2) )
+  if ( (! ui) &&  (args.size() > 1) )
   {
-    //argv[2] is out file name
-    std::string outfile = argv[2];
+    //args[1] is out file name
+    std::string outfile = args[1];
     outfile = outfile + ".root";
     actioninitial->SetDataFilenamemy(outfile);
   }
   //actioninitial->SetDataFilenamemy("out.root");
+#ifdef G4MULTITHREADED
+  G4MTRunManager* runManager = new G4MTRunManager;
+  if ( nThreads <= 0 ) nThreads = G4Threading::G4GetNumberOfCores();
+  // G4FORCENUMBEROFTHREADS, if set, still takes precedence
+  runManager->SetNumberOfThreads(nThreads);
+  G4cout << "Using " << runManager->GetNumberOfThreads()
+         << " worker threads" << G4endl;
+#else
+  if ( nThreads > 1 ) {
+    G4cout << "Geant4 built without multithreading, ignoring -t "
+           << nThreads << G4endl;
+  }
   G4RunManager* runManager = new G4RunManager;
-  
-  // Detector construction
-  runManager->SetUserInitialization(new DetectorConstruction());
-  // Physics list
-  G4VModularPhysicsList* physicsList = new QBBC;
+#endif
+
+  // Detector construction; overlaps are only checked interactively, batch
+  // macros can still run /geometry/test/run
+  auto detector = new DetectorConstruction();
+  detector->SetCheckOverlaps(ui != 0);
+  runManager->SetUserInitialization(detector);
+  // Physics list: full QBBC (hadronics, for neutrons) or EM and decay only
+  G4VModularPhysicsList* physicsList = 0;
+  if ( physics == "qbbc" ) physicsList = new QBBC;
+  else physicsList = new LeanPhysicsList(physics);
+  G4cout << "Physics list " << physics << "+optical" << G4endl;
   physicsList->RegisterPhysics(new G4OpticalPhysics());
+  // Lets the OpticalBoxModel take over optical photons (/toy/optics/fastBox)
+  auto fastSimulationPhysics = new G4FastSimulationPhysics();
+  fastSimulationPhysics->ActivateFastSimulation("opticalphoton");
+  physicsList->RegisterPhysics(fastSimulationPhysics);
   physicsList->SetVerboseLevel(1);
+  // Physics tables are read from the cache directory if a previous job
+  // stored them there for the same physics, materials and cuts, otherwise
+  // they are built and stored after the job
+  PhysicsCache* physicsTableCache = 0;
+  if ( ! physicsCache.empty() ) {
+    physicsTableCache = new PhysicsCache(physicsCache, physics, physicsList);
+  }
   runManager->SetUserInitialization(physicsList);
   // User action initialization
   runManager->SetUserInitialization(actioninitial);
-  // Initialize visualization
+  // Initialize visualization, only needed in interactive mode
   //
-  G4VisManager* visManager = new G4VisExecutive;
-  // G4VisExecutive can take a verbosity argument - see /vis/verbose guidance.
-  // G4VisManager* visManager = new G4VisExecutive("Quiet");
-  visManager->Initialize();
+  G4VisManager* visManager = 0;
+  if ( ui ) {
+    visManager = new G4VisExecutive;
+    // G4VisExecutive can take a verbosity argument - see /vis/verbose guidance.
+    // G4VisManager* visManager = new G4VisExecutive("Quiet");
+    visManager->Initialize();
+  }
 
   // Get the pointer to the User Interface manager
- 
+
 
   // Process macro or start UI session
   //
-  if ( ! ui ) { 
+  if ( ! ui ) {
     // batch mode
     G4String command = "/control/execute ";
-    G4String fileName = argv[1];
+    G4String fileName = args[0];
+    if ( ! replayEvents.empty() ) {
+      G4cout << "Replaying " << replayEvents.size() << " events" << G4endl;
+      UImanager->ApplyCommand("/toy/output/mode step");
+    }
     UImanager->ApplyCommand(command+fileName);
+    // Tables exist once a run has been started
+    if ( physicsTableCache ) physicsTableCache->Store();
   }
-  else { 
+  else {
     // interactive mode
     UImanager->ApplyCommand("/control/execute init_vis.mac");
     ui->SessionStart();
@@ -81,9 +226,10 @@ int main(int argc,char** argv)
 
   // Job termination
   // Free the store: user actions, physics_list and detector_description are
-  // owned and deleted by the run manager, so they should not be deleted 
+  // owned and deleted by the run manager, so they should not be deleted
   // in the main() program !
-  
+
+  delete physicsTableCache;
   delete visManager;
   delete runManager;
 }
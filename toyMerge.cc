@@ -0,0 +1,329 @@
+/// \file toyMerge.cc
+/// \brief Merge the ROOT outputs of several toyMC jobs
+///
+/// Streams the "event" and "step" trees of all shards, entry by entry, into one
+/// compressed ROOT file, and sums their histograms. Event IDs are made unique
+/// by offsetting each shard by the number of events simulated in the shards
+/// before it, taken from the shard's .meta file (out/1.root -> out/1.meta) or,
+/// without it, from the largest eventID found in the shard. The segments of a
+/// checkpointed job (out/1.part0.root, ...) already carry the event IDs of the
+/// job (from the firstEvent of their .meta): they form one job, shifted as a
+/// whole, whatever the order of the segments. A checkpoint file stands for all
+/// the segments it lists.
+///
+///   toyMerge [-o merged.root] [-c compression] out/1.root out/2.ckpt ...
+///
+/// The compression setting follows ROOT: 100*algorithm + level, e.g. 101
+/// (zlib 1), 404 (LZ4 4) or 505 (ZSTD 5).
+
+#include "TFile.h"
+#include "TTree.h"
+#include "TBranch.h"
+#include "TLeaf.h"
+#include "TObjArray.h"
+#include "TH1.h"
+#include "TKey.h"
+#include "TClass.h"
+
+#include <algorithm>
+#include <cctype>
+#include <cstdlib>
+#include <fstream>
+#include <iostream>
+#include <map>
+#include <memory>
+#include <sstream>
+#include <string>
+#include <vector>
+
+namespace {
+
+const char* kTreeNames[] = { "event", "step" };
+
+//....oooOO0OOooo........oooOO0OOooo........oooOO0OOooo........oooOO0OOooo......
+
+/// Buffer of one branch, shared by the input and the output tree
+struct Column
+{
+  std::string name;
+  std::string type;   // Int_t, Float_t, Double_t or vector<float>
+  Int_t    i = 0;
+  Float_t  f = 0.;
+  Double_t d = 0.;
+  std::vector<float>* vf = nullptr;
+
+  void* Address()
+  {
+    if ( type == "Int_t" ) return &i;
+    if ( type == "Float_t" ) return &f;
+    return &d;
+  }
+};
+
+//....oooOO0OOooo........oooOO0OOooo........oooOO0OOooo........oooOO0OOooo......
+
+/// Output tree with the layout of the first input tree of that name
+class MergedTree
+{
+  public:
+    MergedTree(TTree* model, TFile* file)
+    {
+      file->cd();
+      fTree = new TTree(model->GetName(), model->GetTitle());
+      TIter next(model->GetListOfBranches());
+      while ( TBranch* branch = static_cast<TBranch*>(next()) ) {
+        std::unique_ptr<Column> column(new Column);
+        column->name = branch->GetName();
+        std::string className = branch->GetClassName();
+        if ( className == "vector<float>" ) column->type = className;
+        else column->type
+          = static_cast<TLeaf*>(branch->GetListOfLeaves()->At(0))->GetTypeName();
+
+        if ( column->type == "vector<float>" ) {
+          fTree->Branch(column->name.c_str(), &column->vf);
+        }
+        else if ( column->type == "Int_t" || column->type == "Float_t"
+                  || column->type == "Double_t" ) {
+          std::string leaflist = column->name + "/" + column->type.substr(0, 1);
+          fTree->Branch(column->name.c_str(), column->Address(), leaflist.c_str());
+        }
+        else {
+          std::cerr << "toyMerge: skipping branch " << column->name
+                    << " of unsupported type " << column->type << std::endl;
+          continue;
+        }
+        if ( column->name == "eventID" ) fEventID = column.get();
+        fColumns.push_back(std::move(column));
+      }
+    }
+
+    /// Copy all entries of tree, shifting eventID by offset
+    Long64_t Append(TTree* tree, Long64_t offset)
+    {
+      tree->SetBranchStatus("*", 0);
+      for ( auto& column : fColumns ) {
+        if ( ! tree->GetBranch(column->name.c_str()) ) {
+          std::cerr << "toyMerge: " << tree->GetName() << " has no branch "
+                    << column->name << std::endl;
+          return -1;
+        }
+        tree->SetBranchStatus(column->name.c_str(), 1);
+        if ( column->type == "vector<float>" ) {
+          tree->SetBranchAddress(column->name.c_str(), &column->vf);
+        }
+        else {
+          tree->SetBranchAddress(column->name.c_str(), column->Address());
+        }
+      }
+      Long64_t nentries = tree->GetEntries();
+      for ( Long64_t i = 0; i < nentries; ++i ) {
+        tree->GetEntry(i);
+        if ( fEventID ) fEventID->i += offset;
+        fTree->Fill();
+      }
+      tree->ResetBranchAddresses();
+      return nentries;
+    }
+
+    TTree* GetTree() const { return fTree; }
+
+  private:
+    TTree* fTree = nullptr;
+    std::vector<std::unique_ptr<Column> > fColumns;
+    Column* fEventID = nullptr;
+};
+
+//....oooOO0OOooo........oooOO0OOooo........oooOO0OOooo........oooOO0OOooo......
+
+/// Add the histograms (TH1 and TH2) of a shard to the merged ones
+void AddHistograms(TFile* file, TFile* outFile,
+                   std::map<std::string, TH1*>& histograms)
+{
+  TIter next(file->GetListOfKeys());
+  while ( TKey* key = static_cast<TKey*>(next()) ) {
+    TClass* cls = TClass::GetClass(key->GetClassName());
+    if ( ! cls || ! cls->InheritsFrom(TH1::Class()) ) continue;
+    std::unique_ptr<TH1> histogram(static_cast<TH1*>(key->ReadObj()));
+    TH1*& merged = histograms[key->GetName()];
+    if ( merged ) {
+      merged->Add(histogram.get());
+    }
+    else {
+      merged = histogram.release();
+      merged->SetDirectory(outFile);
+    }
+  }
+}
+
+//....oooOO0OOooo........oooOO0OOooo........oooOO0OOooo........oooOO0OOooo......
+
+/// Metadata file of a shard: out/1.root -> out/1.meta
+std::string MetaName(const std::string& shard)
+{
+  std::string meta = shard;
+  std::size_t dot = meta.rfind('.');
+  if ( dot != std::string::npos ) meta = meta.substr(0, dot);
+  return meta + ".meta";
+}
+
+//....oooOO0OOooo........oooOO0OOooo........oooOO0OOooo........oooOO0OOooo......
+
+/// Integer value of key in the metadata of a shard
+bool MetaValue(const std::string& shard, const std::string& key,
+               Long64_t& value)
+{
+  std::ifstream in(MetaName(shard));
+  std::string line;
+  while ( std::getline(in, line) ) {
+    std::istringstream is(line);
+    std::string name;
+    Long64_t number;
+    if ( is >> name >> number && name == key ) {
+      value = number;
+      return true;
+    }
+  }
+  return false;
+}
+
+//....oooOO0OOooo........oooOO0OOooo........oooOO0OOooo........oooOO0OOooo......
+
+/// Number of events simulated in a shard
+Long64_t EventCount(const std::string& shard, TFile* file)
+{
+  Long64_t value;
+  if ( MetaValue(shard, "events", value) ) return value;
+  std::string meta = MetaName(shard);
+
+  // No metadata: assume the last event of the shard has a row
+  TTree* tree = nullptr;
+  file->GetObject("event", tree);
+  if ( ! tree ) file->GetObject("step", tree);
+  if ( ! tree || tree->GetEntries() == 0 ) return 0;
+  std::cerr << "toyMerge: no " << meta << ", counting events of "
+            << shard << " from its largest eventID" << std::endl;
+  return Long64_t(tree->GetMaximum("eventID")) + 1;
+}
+
+//....oooOO0OOooo........oooOO0OOooo........oooOO0OOooo........oooOO0OOooo......
+
+/// Job of a shard: out/1.part3.root -> out/1, out/2.root -> out/2.root
+std::string JobName(const std::string& shard)
+{
+  std::size_t part = shard.rfind(".part");
+  if ( part == std::string::npos ) return shard;
+  std::size_t digits = part + 5;
+  std::size_t end = digits;
+  while ( end < shard.size() && std::isdigit(shard[end]) ) ++end;
+  if ( end == digits || ( end < shard.size() && shard[end] != '.' ) ) return shard;
+  return shard.substr(0, part);
+}
+
+//....oooOO0OOooo........oooOO0OOooo........oooOO0OOooo........oooOO0OOooo......
+
+/// Segments listed in a checkpoint file (out/1.ckpt)
+bool ReadCheckpoint(const std::string& checkpoint,
+                    std::vector<std::string>& segments)
+{
+  std::ifstream in(checkpoint);
+  if ( ! in ) return false;
+  std::string line;
+  while ( std::getline(in, line) ) {
+    std::istringstream is(line);
+    std::string key, segment;
+    if ( is >> key >> segment && key == "segment" ) segments.push_back(segment);
+  }
+  return true;
+}
+
+//....oooOO0OOooo........oooOO0OOooo........oooOO0OOooo........oooOO0OOooo......
+
+void PrintUsage()
+{
+  std::cerr << "Usage: toyMerge [-o merged.root] [-c compression] "
+            << "shard.root|job.ckpt [shard.root|job.ckpt ...]" << std::endl;
+}
+
+}
+
+//....oooOO0OOooo........oooOO0OOooo........oooOO0OOooo........oooOO0OOooo......
+
+int main(int argc, char** argv)
+{
+  std::string outName = "merged.root";
+  int compression = 505;
+  std::vector<std::string> shards;
+  for ( int i = 1; i < argc; ++i ) {
+    std::string arg = argv[i];
+    if ( arg == "-o" && i+1 < argc ) outName = argv[++i];
+    else if ( arg == "-c" && i+1 < argc ) compression = std::atoi(argv[++i]);
+    else if ( arg == "-h" || arg == "--help" ) { PrintUsage(); return 0; }
+    else if ( arg.size() > 5 && arg.compare(arg.size() - 5, 5, ".ckpt") == 0 ) {
+      if ( ! ReadCheckpoint(arg, shards) ) {
+        std::cerr << "toyMerge: cannot read " << arg << std::endl;
+        return 1;
+      }
+    }
+    else shards.push_back(arg);
+  }
+  if ( shards.empty() ) { PrintUsage(); return 1; }
+
+  // Event IDs are shifted per job by the events of the jobs before it; the
+  // segments of a checkpointed job keep their own IDs within the job
+  std::map<std::string, Long64_t> jobEvents;
+  std::vector<std::string> jobs;
+  for ( const auto& shard : shards ) {
+    std::unique_ptr<TFile> file(TFile::Open(shard.c_str(), "READ"));
+    if ( ! file || file->IsZombie() ) continue;
+    Long64_t firstEvent = 0;
+    MetaValue(shard, "firstEvent", firstEvent);
+    std::string job = JobName(shard);
+    if ( ! jobEvents.count(job) ) jobs.push_back(job);
+    Long64_t& events = jobEvents[job];
+    events = std::max(events, firstEvent + EventCount(shard, file.get()));
+  }
+  std::map<std::string, Long64_t> jobOffset;
+  Long64_t offset = 0;
+  for ( const auto& job : jobs ) {
+    jobOffset[job] = offset;
+    offset += jobEvents[job];
+  }
+
+  std::unique_ptr<TFile> outFile(TFile::Open(outName.c_str(), "RECREATE", "",
+                                             compression));
+  if ( ! outFile || outFile->IsZombie() ) {
+    std::cerr << "toyMerge: cannot create " << outName << std::endl;
+    return 1;
+  }
+
+  std::map<std::string, std::unique_ptr<MergedTree> > merged;
+  std::map<std::string, TH1*> histograms;   // owned by outFile
+  for ( const auto& shard : shards ) {
+    std::unique_ptr<TFile> file(TFile::Open(shard.c_str(), "READ"));
+    if ( ! file || file->IsZombie() ) {
+      std::cerr << "toyMerge: skipping unreadable " << shard << std::endl;
+      continue;
+    }
+    Long64_t shift = jobOffset[JobName(shard)];
+    for ( const char* treeName : kTreeNames ) {
+      TTree* tree = nullptr;
+      file->GetObject(treeName, tree);
+      if ( ! tree ) continue;
+      auto& out = merged[treeName];
+      if ( ! out ) out.reset(new MergedTree(tree, outFile.get()));
+      Long64_t nentries = out->Append(tree, shift);
+      if ( nentries < 0 ) return 1;
+      std::cout << shard << ": " << nentries << " " << treeName
+                << " entries, eventID offset " << shift << std::endl;
+    }
+    AddHistograms(file.get(), outFile.get(), histograms);
+  }
+
+  outFile->cd();
+  for ( auto& out : merged ) out.second->GetTree()->Write();
+  for ( auto& histogram : histograms ) histogram.second->Write();
+  std::cout << "toyMerge: " << offset << " events from " << shards.size()
+            << " shards written to " << outName << std::endl;
+  outFile->Close();
+  return 0;
+}